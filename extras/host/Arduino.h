@@ -0,0 +1,97 @@
+/*
+Host (Linux) replacement of the Arduino core, just enough to compile CC1101_RF.
+Licenced under MIT licence
+
+Time does not come from the wall clock. Every call into this "core" charges
+the virtual clock of the simulator with the time the same call would take
+on the MCU (see SimCosts in CC1101Sim.h). The pins used by the CC1101 (CSN
+MISO GDO0 GDO2) are wired to the software model of the chip.
+*/
+
+#ifndef HOST_Arduino_h
+#define HOST_Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+// Lets the library and the sketches know they run on the simulator
+#define CC1101_HOST 1
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+// the same values as the AVR core
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define DEC 10
+#define HEX 16
+#define BIN 2
+
+// Flash and RAM are the same thing here
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define vsnprintf_P vsnprintf
+
+#define bit(b) (1UL << (b))
+
+// An atmega328p like pinout
+static const uint8_t SS   = 10;
+static const uint8_t MOSI = 11;
+static const uint8_t MISO = 12;
+static const uint8_t SCK  = 13;
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+// The cost of a direct port access (Teensy and other cores have them)
+void digitalWriteFast(uint8_t pin, uint8_t val);
+int digitalReadFast(uint8_t pin);
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// Every pin can be used as an interrupt, the interrupt number is the pin number
+#define digitalPinToInterrupt(p) (p)
+void attachInterrupt(uint8_t interruptNum, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t interruptNum);
+void noInterrupts(void);
+void interrupts(void);
+
+// The base class of Serial etc. Only the binary writes
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t b) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        size_t n = 0;
+        while (size--) n += write(*buffer++);
+        return n;
+    }
+};
+
+// deterministic, see SimHost::seed()
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+#endif
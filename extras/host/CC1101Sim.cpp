@@ -0,0 +1,1116 @@
+/*
+Software model of the CC1101 chip, used by the host build of CC1101_RF.
+Licenced under MIT licence
+See CC1101Sim.h
+*/
+
+#include "CC1101Sim.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#define NEVER (~0ull)
+
+static const double FXOSC = 26000000.0;
+
+// ns for a number of crystal periods
+static uint64_t xoscNs(uint32_t cycles) {
+    return (uint64_t)(cycles * 1e9 / FXOSC);
+}
+
+// SWRS061I table 34 (26MHz crystal)
+static const uint64_t CAL_NS = xoscNs(18739);          // FS calibration
+static const uint64_t IDLE_RX_NS = xoscNs(1953);       // IDLE -> RX no calibration
+static const uint64_t IDLE_TX_NS = xoscNs(1954);       // IDLE -> TX/FSTXON no calibration
+static const uint64_t SWITCH_NS = xoscNs(782);         // RX <-> TX, FSTXON -> TX/RX
+static const uint64_t XOSC_START_NS = 150000;          // CHIP_RDYn after power down
+static const uint64_t RESET_NS = 41000;                // SRES
+
+// Register values after reset (SWRS061I table 43)
+static const uint8_t resetRegs[0x2F] = {
+    0x29, 0x2E, 0x3F, 0x07, 0xD3, 0x91, 0xFF, 0x04, 0x45, 0x00, 0x00, 0x0F, 0x00, 0x1E, 0xC4, 0xEC,
+    0x8C, 0x22, 0x02, 0x22, 0xF8, 0x47, 0x07, 0x30, 0x04, 0x36, 0x6C, 0x03, 0x40, 0x91, 0x87, 0x6B,
+    0xF8, 0x56, 0x10, 0xA9, 0x0A, 0x20, 0x0D, 0x41, 0x00, 0x59, 0x7F, 0x3F, 0x88, 0x31, 0x0B
+};
+
+// The RX timeout of WOR in EVENT0 units (us), SWRS061I table 31, index [WOR_RES][RX_TIME]
+static const double worRxTime[4][7] = {
+    {3.6058, 1.8029, 0.9014, 0.4507, 0.2254, 0.1127, 0.0563},
+    {18.0288, 9.0144, 4.5072, 2.2536, 1.1268, 0.5634, 0.2817},
+    {32.4519, 16.2260, 8.1130, 4.0565, 2.0282, 1.0141, 0.5071},
+    {46.8750, 23.4375, 11.7188, 5.8594, 2.9297, 1.4648, 0.7324}
+};
+
+static const uint8_t event1Periods[8] = {4, 6, 8, 12, 16, 24, 32, 48};
+static const uint8_t preambleTable[8] = {2, 3, 4, 6, 8, 12, 16, 24};
+
+// The values the calibration would find. A calibration is good for ~100KHz
+static void fscalFor(double freqHz, uint8_t& f3, uint8_t& f2, uint8_t& f1) {
+    uint32_t h = (uint32_t)(freqHz / 100000.0) * 2654435761u;
+    f3 = (h >> 8) & 0x0F;
+    f2 = (h >> 12) & 0x1F;
+    f1 = (h >> 20) & 0x3F;
+}
+
+static uint8_t rssiReg(int dbm) {
+    int d = (dbm + 74) * 2;
+    if (d > 127) d = 127;
+    if (d < -128) d = -128;
+    return (uint8_t)(int8_t)d;
+}
+
+SimCosts::SimCosts()
+: digitalWriteNs(6000), digitalReadNs(5500), pinModeNs(6000), portAccessNs(250), timeCallNs(2000),
+spiClockHz(2000000), spiByteCallNs(1500), spiBufferCallNs(1500), spiBufferByteNs(250),
+spiTransactionNs(1500), mcuHz(8000000) {
+}
+
+uint32_t SimCosts::spiClockFor(uint32_t requested) const {
+    uint32_t clk = mcuHz / 2;
+    while (clk > requested && clk > mcuHz / 128) clk /= 2;
+    return clk;
+}
+
+uint64_t SimCosts::spiBitsNs(uint32_t bits) const {
+    return (uint64_t)bits * 1000000000ull / spiClockHz;
+}
+
+void SimBusStats::reset() {
+    memset(this, 0, sizeof(*this));
+}
+
+//////////////////////////////////////////// CC1101Sim ////////////////////////////////////////////
+
+CC1101Sim::CC1101Sim(SimHost& _host, uint8_t _id, uint8_t csn, uint8_t miso, uint8_t gdo0, uint8_t gdo2)
+: id(_id), csnPin(csn), misoPin(miso), gdo0Pin(gdo0), gdo2Pin(gdo2),
+calibrations(0), framesSent(0), framesReceived(0), framesDiscarded(0), rxOverflows(0),
+txUnderflows(0), wakeups(0), txRssiDbm(-60), txLqi(2), host(_host),
+isSelected(false), stateSince(0) {
+    memset(stateAcc, 0, sizeof(stateAcc));
+    ms = M_IDLE;
+    resetChip(host.now());
+    readyAt = 0;
+}
+
+void CC1101Sim::resetChip(uint64_t now) {
+    memcpy(regs, resetRegs, sizeof(regs));
+    memset(pa, 0, sizeof(pa));
+    pa[0] = 0xC6;
+    paIndex = 0;
+    rxFifo.clear();
+    txFifo.clear();
+    rxUnderOverflow = txUnderflow = false;
+    expectHeader = true;
+    spiAddr = 0;
+    spiRead = spiBurst = false;
+    pendingPowerDown = pendingXoff = false;
+    if (txFrame) abortTX(now);
+    abortRX(now);
+    setState(M_IDLE, now);
+    autoIdleCount = 0;
+    pktCrcOkFlag = false;
+    rxPktEnd = false;
+    lastRssi = lastLqi = 0;
+    worOn = worRx = false;
+    worNext = worRxAt = worTimeoutAt = worRssiCheckAt = 0;
+}
+
+uint8_t CC1101Sim::stateClass() const {
+    switch (ms) {
+        case M_SLEEP: case M_XOFF: return T_SLEEP;
+        case M_IDLE: return T_IDLE;
+        case M_RX: return T_RX;
+        case M_TX: return T_TX;
+        default: return T_OTHER;
+    }
+}
+
+void CC1101Sim::setState(uint8_t s, uint64_t now) {
+    // FSTEST PTEST AGCTEST TEST2 TEST1 TEST0 are not retained in SLEEP (SWRS061I 10.5)
+    if (s == M_SLEEP) memcpy(regs + 0x29, resetRegs + 0x29, 6);
+    stateAcc[stateClass()] += now - stateSince;
+    stateSince = now;
+    ms = s;
+    transAt = 0;
+}
+
+uint64_t CC1101Sim::stateNs(uint8_t t, uint64_t now) const {
+    return stateAcc[t] + (stateClass() == t ? now - stateSince : 0);
+}
+
+uint8_t CC1101Sim::statusState() const {
+    switch (ms) {
+        case M_SLEEP: case M_XOFF: case M_IDLE: return 0;
+        case M_RX: return 1;
+        case M_TX: return 2;
+        case M_FSTXON: return 3;
+        case M_STARTCAL: return 4;
+        case M_RXFIFO_OVERFLOW: return 6;
+        case M_TXFIFO_UNDERFLOW: return 7;
+        default: return 5; // settling
+    }
+}
+
+uint8_t CC1101Sim::statusByte(bool read) const {
+    uint8_t fifo = read ? rxFifo.size() : 64 - txFifo.size();
+    if (fifo > 15) fifo = 15;
+    return (ready(host.now()) ? 0 : 0x80) | (statusState() << 4) | fifo;
+}
+
+double CC1101Sim::carrierHz() const {
+    uint32_t word = ((uint32_t)regs[0x0D] << 16) | ((uint32_t)regs[0x0E] << 8) | regs[0x0F];
+    double spacing = FXOSC / (1 << 18) * (256 + regs[0x14]) * (1 << (regs[0x13] & 3));
+    return word * FXOSC / 65536.0 + regs[0x0A] * spacing;
+}
+
+double CC1101Sim::channelBwHz() const {
+    uint8_t e = regs[0x10] >> 6, m = (regs[0x10] >> 4) & 3;
+    return FXOSC / (8.0 * (4 + m) * (1 << e));
+}
+
+double CC1101Sim::dataRate() const {
+    return (256.0 + regs[0x11]) * (double)(1ul << (regs[0x10] & 0x0F)) * FXOSC / 268435456.0;
+}
+
+uint32_t CC1101Sim::byteNs() const {
+    double ns = 8e9 / dataRate();
+    if (regs[0x12] & 0x08) ns *= 2; // manchester
+    return (uint32_t)ns;
+}
+
+uint32_t CC1101Sim::rssiPeriodNs() const {
+    return (uint32_t)((8 << (regs[0x1D] & 3)) / (2 * channelBwHz()) * 1e9);
+}
+
+uint32_t CC1101Sim::preambleBytes() const {
+    return preambleTable[(regs[0x13] >> 4) & 7];
+}
+
+uint32_t CC1101Sim::syncBytes() const {
+    switch (regs[0x12] & 7) {
+        case 0: case 4: return 0;
+        case 3: case 7: return 4;
+        default: return 2;
+    }
+}
+
+uint32_t CC1101Sim::syncWord() const {
+    return (syncBytes() << 16) | (regs[0x04] << 8) | regs[0x05];
+}
+
+uint8_t CC1101Sim::frameFormat() const {
+    return (regs[0x08] & 0x40) | (regs[0x12] & 0x08) | ((regs[0x12] >> 4) & 7);
+}
+
+bool CC1101Sim::synthLocked() const {
+    uint8_t f3, f2, f1;
+    fscalFor(carrierHz(), f3, f2, f1);
+    return (regs[0x23] & 0x0F) == f3 && (regs[0x24] & 0x1F) == f2 && (regs[0x25] & 0x3F) == f1;
+}
+
+void CC1101Sim::calibrate() {
+    uint8_t f3, f2, f1;
+    fscalFor(carrierHz(), f3, f2, f1);
+    regs[0x23] = (regs[0x23] & 0xF0) | f3;
+    regs[0x24] = (regs[0x24] & 0x20) | f2;
+    regs[0x25] = f1;
+    calibrations++;
+}
+
+int CC1101Sim::channelRssi(uint64_t now) const {
+    return host.levelAt(carrierHz(), channelBwHz(), now, id);
+}
+
+bool CC1101Sim::carrierSense(uint64_t now) const {
+    return channelRssi(now) >= host.ccaThresholdDbm;
+}
+
+uint64_t CC1101Sim::worEvent0Ns() const {
+    uint32_t event0 = ((uint32_t)regs[0x1E] << 8) | regs[0x1F];
+    return (uint64_t)(750e9 / FXOSC * event0 * (1ul << (5 * (regs[0x20] & 3))));
+}
+
+bool CC1101Sim::misoLevel(uint64_t now) const {
+    if (!isSelected) return true;
+    return !ready(now);
+}
+
+bool CC1101Sim::gdoLevel(uint8_t gdo, uint64_t now) const {
+    uint8_t cfg = regs[gdo == 0 ? 0x02 : 0x00];
+    uint8_t thr = 4 * ((regs[0x03] & 0x0F) + 1);
+    bool level;
+    switch (cfg & 0x3F) {
+        case 0x00: level = rxFifo.size() >= thr; break;
+        case 0x01: level = rxFifo.size() >= thr || (rxPktEnd && !rxFifo.empty()); break;
+        case 0x02: level = txFifo.size() >= (uint8_t)(65 - thr); break;
+        case 0x03: level = txFifo.size() >= 64; break;
+        case 0x04: level = rxUnderOverflow; break;
+        case 0x05: level = txUnderflow; break;
+        case 0x06:
+            level = (ms == M_TX && txFrame && txFrame->syncEnd <= now) || (rxFrame && ms == M_RX);
+            break;
+        case 0x07: level = pktCrcOkFlag; break;
+        case 0x09: level = isRx() && !carrierSense(now); break;
+        case 0x0E: level = isRx() && carrierSense(now); break;
+        case 0x29: level = !ready(now); break;
+        default: level = false; break;
+    }
+    return (cfg & 0x40) ? !level : level;
+}
+
+void CC1101Sim::csn(bool level, uint64_t now) {
+    if (!level) {
+        if (isSelected) return;
+        isSelected = true;
+        expectHeader = true;
+        if (ms == M_SLEEP || ms == M_XOFF) {
+            // CSn low wakes the chip, it goes to IDLE when the crystal is running
+            worOn = worRx = false;
+            worRxAt = worTimeoutAt = worRssiCheckAt = 0;
+            setState(M_IDLE, now);
+            readyAt = now + XOSC_START_NS;
+        }
+    } else {
+        if (!isSelected) return;
+        isSelected = false;
+        paIndex = 0;
+        if (pendingPowerDown && ms == M_IDLE) {
+            setState(M_SLEEP, now);
+            readyAt = NEVER;
+        } else if (pendingXoff && ms == M_IDLE) {
+            setState(M_XOFF, now);
+            readyAt = NEVER;
+        }
+        pendingPowerDown = pendingXoff = false;
+    }
+}
+
+uint8_t CC1101Sim::readStatusReg(uint8_t addr, uint64_t now) {
+    switch (addr) {
+        case 0x30: return 0x00; // PARTNUM
+        case 0x31: return 0x14; // VERSION
+        case 0x33: return lastLqi;
+        case 0x34: return isRx() ? rssiReg(channelRssi(now)) : lastRssi;
+        case 0x35: return ms;
+        case 0x36: case 0x37: {
+            uint16_t t = worOn ? (uint16_t)((now - worStart) * FXOSC / 750e9) : 0;
+            return addr == 0x36 ? t >> 8 : t & 0xFF;
+        }
+        case 0x38: {
+            bool cs = isRx() && carrierSense(now);
+            return (pktCrcOkFlag ? 0x80 : 0) | (cs ? 0x40 : 0) | (rxFrame ? 0x28 : 0) |
+                (cs ? 0 : 0x10) | (gdoLevel(2, now) ? 0x04 : 0) | (gdoLevel(0, now) ? 0x01 : 0);
+        }
+        case 0x39: return 0x94;
+        case 0x3A: return (txUnderflow ? 0x80 : 0) | txFifo.size();
+        case 0x3B: return (rxUnderOverflow ? 0x80 : 0) | rxFifo.size();
+        default: return 0;
+    }
+}
+
+void CC1101Sim::writeReg(uint8_t addr, uint8_t value) {
+    if (addr < 0x2F) regs[addr] = value;
+}
+
+uint8_t CC1101Sim::spiByte(uint8_t b, uint64_t now) {
+    if (!isSelected || !ready(now)) return 0xFF;
+    if (expectHeader) {
+        host.bus.headers++;
+        spiAddr = b & 0x3F;
+        spiRead = b & 0x80;
+        spiBurst = b & 0x40;
+        uint8_t status = statusByte(spiRead);
+        if (spiAddr >= 0x30 && spiAddr <= 0x3D && !spiBurst) {
+            host.bus.strobes++;
+            if (spiAddr == 0x3D) host.bus.snops++;
+            execStrobe(spiAddr, now);
+        } else {
+            expectHeader = false;
+        }
+        return status;
+    }
+    uint8_t out = 0;
+    if (spiAddr == 0x3F) {
+        if (spiRead) {
+            if (!rxFifo.empty()) {
+                out = rxFifo.front();
+                rxFifo.erase(rxFifo.begin());
+                pktCrcOkFlag = false;
+                if (rxFifo.empty()) rxPktEnd = false;
+            }
+        } else if (txFifo.size() < 64) {
+            txFifo.push_back(b);
+        }
+    } else if (spiAddr == 0x3E) {
+        if (spiRead) out = pa[paIndex];
+        else pa[paIndex] = b;
+        paIndex = (paIndex + 1) & 7;
+    } else if (spiAddr >= 0x30) {
+        if (spiRead) out = readStatusReg(spiAddr, now);
+    } else {
+        if (spiRead) out = spiAddr < 0x2F ? regs[spiAddr] : 0;
+        else writeReg(spiAddr, b);
+        if (spiBurst) spiAddr++;
+    }
+    if (!spiBurst) expectHeader = true;
+    return out;
+}
+
+void CC1101Sim::execStrobe(uint8_t s, uint64_t now) {
+    switch (s) {
+        case 0x30: // SRES
+            resetChip(now);
+            readyAt = now + RESET_NS;
+            break;
+        case 0x31: // SFSTXON
+            if (ms == M_IDLE) startTransition(M_FSTXON, now);
+            else if (ms == M_RX) {
+                abortRX(now);
+                setState(M_FSTXON, now);
+            }
+            break;
+        case 0x32: // SXOFF
+            if (ms == M_IDLE) pendingXoff = true;
+            break;
+        case 0x33: // SCAL
+            if (ms == M_IDLE) {
+                setState(M_STARTCAL, now);
+                transGoal = M_IDLE;
+                transAt = now + CAL_NS;
+            }
+            break;
+        case 0x34: // SRX
+            if (ms == M_IDLE) startTransition(M_RX, now);
+            else if (ms == M_FSTXON) {
+                setState(M_TXRX_SWITCH, now);
+                transGoal = M_RX;
+                transAt = now + SWITCH_NS;
+            }
+            break;
+        case 0x35: // STX
+            if (ms == M_IDLE) startTransition(M_TX, now);
+            else if (ms == M_FSTXON) {
+                setState(M_RXTX_SWITCH, now);
+                transGoal = M_TX;
+                transAt = now + SWITCH_NS;
+            } else if (ms == M_RX) {
+                uint8_t cca = (regs[0x17] >> 4) & 3;
+                bool busy = false;
+                if ((cca & 1) && carrierSense(now)) busy = true;
+                if ((cca & 2) && rxFrame) busy = true;
+                if (busy) break; // stays in RX
+                abortRX(now);
+                setState(M_RXTX_SWITCH, now);
+                transGoal = M_TX;
+                transAt = now + SWITCH_NS;
+            }
+            break;
+        case 0x36: // SIDLE
+            worOn = worRx = false;
+            worRxAt = worTimeoutAt = worRssiCheckAt = 0;
+            if (txFrame) abortTX(now);
+            abortRX(now);
+            if (ms != M_SLEEP && ms != M_XOFF) setState(M_IDLE, now);
+            break;
+        case 0x38: // SWOR
+            if (ms == M_IDLE || ms == M_RX) {
+                abortRX(now);
+                worOn = true;
+                worRx = false;
+                worStart = now;
+                worNext = now + worEvent0Ns();
+                worRxAt = worTimeoutAt = worRssiCheckAt = 0;
+                setState(M_SLEEP, now);
+                readyAt = NEVER;
+            }
+            break;
+        case 0x39: // SPWD
+            if (ms == M_IDLE) pendingPowerDown = true;
+            break;
+        case 0x3A: // SFRX
+            if (ms == M_IDLE || ms == M_RXFIFO_OVERFLOW) {
+                rxFifo.clear();
+                rxUnderOverflow = false;
+                rxPktEnd = false;
+                pktCrcOkFlag = false;
+                if (ms != M_IDLE) setState(M_IDLE, now);
+            }
+            break;
+        case 0x3B: // SFTX
+            if (ms == M_IDLE || ms == M_TXFIFO_UNDERFLOW) {
+                txFifo.clear();
+                txUnderflow = false;
+                if (ms != M_IDLE) setState(M_IDLE, now);
+            }
+            break;
+        case 0x3C: // SWORRST
+            if (worOn) {
+                worStart = now;
+                worNext = now + worEvent0Ns();
+            }
+            break;
+        default: // SAFC SNOP
+            break;
+    }
+}
+
+// From IDLE to RX/TX/FSTXON, calibrating if MCSM0.FS_AUTOCAL=1
+void CC1101Sim::startTransition(uint8_t goal, uint64_t now) {
+    uint8_t autocal = (regs[0x18] >> 4) & 3;
+    transGoal = goal;
+    if (autocal == 1) {
+        setState(M_STARTCAL, now);
+        transGoal = goal;
+        transAt = now + CAL_NS;
+    } else {
+        setState(M_FS_LOCK, now);
+        transGoal = goal;
+        transAt = now + (goal == M_RX ? IDLE_RX_NS : IDLE_TX_NS);
+    }
+}
+
+// RX/TX -> IDLE automatically, calibrating if MCSM0.FS_AUTOCAL=2,3
+void CC1101Sim::goIdleAuto(uint64_t now) {
+    uint8_t autocal = (regs[0x18] >> 4) & 3;
+    bool cal = autocal == 2 || (autocal == 3 && (++autoIdleCount & 3) == 0);
+    if (cal) {
+        setState(M_STARTCAL, now);
+        transGoal = M_IDLE;
+        transAt = now + CAL_NS;
+    } else {
+        setState(M_IDLE, now);
+    }
+}
+
+void CC1101Sim::reachGoal(uint8_t goal, uint64_t now) {
+    switch (goal) {
+        case M_RX: enterRX(now); break;
+        case M_TX: enterTX(now); break;
+        default: setState(goal, now); break;
+    }
+}
+
+// TXOFF_MODE / RXOFF_MODE
+void CC1101Sim::afterPacket(uint8_t offMode, uint64_t now) {
+    bool fromTx = ms == M_TX;
+    switch (offMode) {
+        case 0: goIdleAuto(now); break;
+        case 1: setState(M_FSTXON, now); break;
+        case 2:
+            if (fromTx) enterTX(now);
+            else {
+                setState(M_RXTX_SWITCH, now);
+                transGoal = M_TX;
+                transAt = now + SWITCH_NS;
+            }
+            break;
+        default:
+            if (!fromTx) enterRX(now);
+            else {
+                setState(M_TXRX_SWITCH, now);
+                transGoal = M_RX;
+                transAt = now + SWITCH_NS;
+            }
+            break;
+    }
+}
+
+void CC1101Sim::enterRX(uint64_t now) {
+    setState(M_RX, now);
+    rxSince = rxScanFrom = now;
+    rxFrame.reset();
+    rxStatusAt = 0;
+    rxPushed = 0;
+    if (worRx) {
+        uint8_t rxTime = regs[0x16] & 7;
+        if (rxTime < 7) {
+            uint32_t event0 = ((uint32_t)regs[0x1E] << 8) | regs[0x1F];
+            worTimeoutAt = now + (uint64_t)(event0 * worRxTime[regs[0x20] & 3][rxTime] * 1000 * 26e6 / FXOSC);
+        }
+        // RX_TIME_RSSI : the RSSI is valid after 2 updates
+        if (regs[0x16] & 0x10) worRssiCheckAt = now + 2 * rssiPeriodNs();
+    }
+}
+
+void CC1101Sim::enterTX(uint64_t now) {
+    setState(M_TX, now);
+    txPhase = TX_PREAMBLE;
+    txNext = now + preambleBytes() * byteNs();
+    txCount = txTotal = 0;
+    txByteInFlight = false;
+    std::shared_ptr<SimFrame> f(new SimFrame());
+    f->src = id;
+    f->freqHz = synthLocked() ? carrierHz() : NAN;
+    f->dataRate = dataRate();
+    f->sync = syncWord();
+    f->format = frameFormat();
+    f->rssiDbm = txRssiDbm;
+    f->lqi = txLqi;
+    f->start = now;
+    f->syncEnd = f->end = NEVER;
+    f->dataDone = false;
+    f->crc = regs[0x08] & 0x04;
+    f->crcOk = true;
+    f->corrupt = f->aborted = false;
+    txFrame = f;
+    host.frameStarted(f);
+}
+
+void CC1101Sim::abortTX(uint64_t now) {
+    if (!txFrame) return;
+    txFrame->aborted = true;
+    txFrame->end = now;
+    txFrame.reset();
+}
+
+void CC1101Sim::abortRX(uint64_t now) {
+    (void)now;
+    rxFrame.reset();
+    rxStatusAt = 0;
+    rxPushed = 0;
+}
+
+// true when the packet is complete after count bytes. first is the first byte
+bool CC1101Sim::lengthDone(uint16_t count, uint16_t first) const {
+    switch (regs[0x08] & 3) {
+        case 0: return (count & 0xFF) == regs[0x06];     // fixed, PKTLEN=0 means 256
+        case 1: return count >= first + 1;               // variable
+        default: return false;                           // infinite
+    }
+}
+
+void CC1101Sim::processTX(uint64_t now) {
+    uint32_t bt = byteNs();
+    switch (txPhase) {
+        case TX_PREAMBLE:
+            // the preamble is sent until there is something in the TX FIFO
+            if (txFifo.empty()) {
+                txNext += bt;
+                return;
+            }
+            txPhase = TX_SYNC;
+            txNext = now + syncBytes() * bt;
+            return;
+        case TX_SYNC:
+            txFrame->syncEnd = now;
+            txPhase = TX_DATA;
+            break;
+        case TX_DATA:
+            txFrame->data.push_back(txByte);
+            txFrame->at.push_back(now);
+            txCount++;
+            if (lengthDone(txCount, txFrame->data[0])) {
+                txFrame->dataDone = true;
+                if (txFrame->crc) {
+                    txPhase = TX_CRC;
+                    txNext = now + 2 * bt;
+                    return;
+                }
+                txPhase = TX_CRC; // no CRC, done now
+            } else break;
+            // fall through
+        case TX_CRC:
+            txFrame->end = now;
+            txFrame.reset();
+            framesSent++;
+            afterPacket(regs[0x17] & 3, now);
+            return;
+    }
+    // next data byte
+    if (txFifo.empty()) {
+        txUnderflows++;
+        txUnderflow = true;
+        abortTX(now);
+        setState(M_TXFIFO_UNDERFLOW, now);
+        return;
+    }
+    txByte = txFifo.front();
+    txFifo.erase(txFifo.begin());
+    txNext = now + bt;
+}
+
+bool CC1101Sim::frameMatches(const SimFrame& f) const {
+    if (f.src == id || isnan(f.freqHz) || !synthLocked()) return false;
+    if (fabs(f.freqHz - carrierHz()) > channelBwHz() / 4) return false;
+    if (fabs(f.dataRate - dataRate()) > dataRate() * 0.01) return false;
+    return f.sync == syncWord() && f.format == frameFormat();
+}
+
+uint64_t CC1101Sim::rxNextEvent() const {
+    if (rxStatusAt) return rxStatusAt;
+    if (rxFrame) {
+        if (rxIdx < rxFrame->at.size()) return rxFrame->at[rxIdx];
+        return rxFrame->end;
+    }
+    uint64_t t = NEVER;
+    std::vector<std::shared_ptr<SimFrame> >& air = host.air();
+    for (size_t i = 0; i < air.size(); i++) {
+        uint64_t s = air[i]->syncEnd;
+        if (s != NEVER && s >= rxScanFrom && s < t) t = s;
+    }
+    return t;
+}
+
+bool CC1101Sim::rxPush(uint8_t b, uint64_t now) {
+    if (rxFifo.size() >= 64) {
+        rxOverflows++;
+        rxUnderOverflow = true;
+        abortRX(now);
+        setState(M_RXFIFO_OVERFLOW, now);
+        return false;
+    }
+    rxFifo.push_back(b);
+    rxPushed++;
+    return true;
+}
+
+// length or address filter, the bytes of the packet are removed
+void CC1101Sim::rxDiscard() {
+    rxFifo.resize(rxFifo.size() - std::min<size_t>(rxPushed, rxFifo.size()));
+    framesDiscarded++;
+    rxFrame.reset();
+    rxPushed = 0;
+    rxSince = host.now(); // a new preamble is needed
+}
+
+void CC1101Sim::rxFinish(uint64_t now) {
+    bool ok = !rxFrameBad && !rxFrame->corrupt && rxFrame->crcOk && rxFrame->dataDone &&
+        rxFrame->data.size() == rxIdx;
+    if (!(regs[0x08] & 0x04)) ok = true; // CRC disabled
+    else if (!rxFrame->crc) ok = false;
+    lastRssi = rssiReg(host.rssiAt(*rxFrame, *this));
+    lastLqi = (ok ? 0x80 : 0) | (rxFrame->lqi & 0x7F);
+    if (regs[0x07] & 0x04) { // APPEND_STATUS
+        if (!rxPush(lastRssi, now)) return;
+        if (!rxPush(lastLqi, now)) return;
+    }
+    framesReceived++;
+    if (!ok && (regs[0x07] & 0x08)) { // CRC_AUTOFLUSH
+        rxFifo.clear();
+    } else {
+        pktCrcOkFlag = ok;
+        rxPktEnd = true;
+    }
+    rxFrame.reset();
+    rxStatusAt = 0;
+    rxPushed = 0;
+    worRx = false;
+    worTimeoutAt = worRssiCheckAt = 0;
+    afterPacket((regs[0x17] >> 2) & 3, now);
+}
+
+void CC1101Sim::processRX(uint64_t now) {
+    if (rxStatusAt) {
+        rxFinish(now);
+        return;
+    }
+    if (rxFrame) {
+        if (rxIdx >= rxFrame->at.size()) {
+            // the transmitter stopped before the end of the packet
+            rxFrameBad = true;
+            rxFinish(now);
+            return;
+        }
+        uint8_t b = rxFrame->data[rxIdx];
+        uint16_t idx = rxIdx++;
+        bool variable = (regs[0x08] & 3) == 1;
+        if (variable && idx == 0 && b > regs[0x06]) {
+            rxDiscard();
+            return;
+        }
+        uint8_t adrChk = regs[0x07] & 3;
+        if (adrChk && idx == (variable ? 1 : 0)) {
+            bool ok = b == regs[0x09] || (adrChk >= 2 && b == 0) || (adrChk == 3 && b == 0xFF);
+            if (!ok) {
+                rxDiscard();
+                return;
+            }
+        }
+        if (!rxPush(b, now)) return;
+        if (lengthDone(rxIdx, rxFrame->data[0])) {
+            if (regs[0x08] & 0x04) rxStatusAt = now + 2 * byteNs();
+            else rxFinish(now);
+        }
+        return;
+    }
+    // searching for a sync word
+    std::vector<std::shared_ptr<SimFrame> >& air = host.air();
+    uint64_t first = NEVER;
+    for (size_t i = 0; i < air.size(); i++) {
+        uint64_t s = air[i]->syncEnd;
+        if (s != NEVER && s >= rxScanFrom && s < first) first = s;
+    }
+    if (first == NEVER || first > now) return;
+    for (size_t i = 0; i < air.size(); i++) {
+        SimFrame& f = *air[i];
+        if (f.syncEnd != first || !frameMatches(f)) continue;
+        // the receiver needs some preamble bytes to detect the packet
+        uint64_t need = (uint64_t)(syncBytes() + 2) * byteNs();
+        if (f.syncEnd < rxSince + need) continue;
+        if (host.rand01() < host.lossRate) continue;
+        rxFrame = air[i];
+        rxFrameBad = host.rand01() < host.corruptRate;
+        rxIdx = 0;
+        rxPushed = 0;
+        rxStatusAt = 0;
+        worTimeoutAt = worRssiCheckAt = 0; // sync found, the WOR RX continues
+        break;
+    }
+    rxScanFrom = first + 1;
+}
+
+void CC1101Sim::worSleep(uint64_t now) {
+    uint8_t autocal = (regs[0x18] >> 4) & 3;
+    if (autocal == 2 || (autocal == 3 && (++autoIdleCount & 3) == 0)) calibrate();
+    worRx = false;
+    worTimeoutAt = worRssiCheckAt = 0;
+    abortRX(now);
+    setState(M_SLEEP, now);
+    readyAt = NEVER;
+}
+
+void CC1101Sim::processWOR(uint64_t now) {
+    if (worNext && now >= worNext) {
+        wakeups++;
+        worNext += worEvent0Ns();
+        if (ms == M_SLEEP || ms == M_IDLE) {
+            uint8_t e1 = event1Periods[(regs[0x20] >> 4) & 7];
+            worRxAt = now + (uint64_t)(e1 * 750e9 / FXOSC);
+        }
+        return;
+    }
+    if (worRxAt && now >= worRxAt) {
+        worRxAt = 0;
+        readyAt = now;
+        setState(M_IDLE, now);
+        worRx = true;
+        startTransition(M_RX, now);
+        return;
+    }
+    if (worRssiCheckAt && now >= worRssiCheckAt) {
+        worRssiCheckAt = 0;
+        if (!carrierSense(now) && !rxFrame) worSleep(now);
+        return;
+    }
+    if (worTimeoutAt && now >= worTimeoutAt) {
+        worTimeoutAt = 0;
+        bool keep = rxFrame != NULL;
+        // RX_TIME_QUAL=1 : a preamble is enough
+        if ((regs[0x16] & 0x08) && carrierSense(now)) keep = true;
+        if (!keep) worSleep(now);
+        else worRx = false;
+    }
+}
+
+uint64_t CC1101Sim::nextEvent() const {
+    uint64_t t = NEVER;
+    if (transAt) t = transAt;
+    if (ms == M_TX) t = std::min(t, txNext);
+    if (ms == M_RX) t = std::min(t, rxNextEvent());
+    if (worOn) {
+        t = std::min(t, worNext);
+        if (worRxAt) t = std::min(t, worRxAt);
+        if (ms == M_RX && worRssiCheckAt) t = std::min(t, worRssiCheckAt);
+        if (ms == M_RX && worTimeoutAt) t = std::min(t, worTimeoutAt);
+    }
+    return t;
+}
+
+void CC1101Sim::process(uint64_t now) {
+    if (transAt && now >= transAt) {
+        uint8_t goal = transGoal;
+        if (ms == M_STARTCAL) {
+            calibrate();
+            if (goal == M_IDLE) setState(M_IDLE, now);
+            else {
+                setState(M_FS_LOCK, now);
+                transGoal = goal;
+                transAt = now + (goal == M_RX ? IDLE_RX_NS : IDLE_TX_NS);
+            }
+        } else {
+            reachGoal(goal, now);
+        }
+        return;
+    }
+    if (worOn) {
+        bool due = (worNext && now >= worNext) || (worRxAt && now >= worRxAt) ||
+            (ms == M_RX && ((worRssiCheckAt && now >= worRssiCheckAt) || (worTimeoutAt && now >= worTimeoutAt)));
+        if (due) {
+            processWOR(now);
+            return;
+        }
+    }
+    if (ms == M_TX && now >= txNext) {
+        processTX(now);
+        return;
+    }
+    if (ms == M_RX && now >= rxNextEvent()) {
+        processRX(now);
+        return;
+    }
+}
+
+//////////////////////////////////////////// SimHost ////////////////////////////////////////////
+
+SimHost& SimHost::get() {
+    static SimHost host;
+    return host;
+}
+
+SimHost::SimHost() : logging(true), noiseFloorDbm(-105), ccaThresholdDbm(-90), rssiDelayNs(0),
+lossRate(0), corruptRate(0), t(0), rng(1), interruptsOn(true), inIsr(false), csnActive(-1) {
+    bus.reset();
+    memset(pinLevel, 0, sizeof(pinLevel));
+    memset(gdoLevel, 0, sizeof(gdoLevel));
+    memset(isrs, 0, sizeof(isrs));
+}
+
+void SimHost::reset() {
+    chips.clear();
+    frames.clear();
+    lastFrame.reset();
+    interferers.clear();
+    log.clear();
+    bus.reset();
+    t = 0;
+    rng = 1;
+    lossRate = corruptRate = 0;
+    rssiDelayNs = 0;
+    interruptsOn = true;
+    inIsr = false;
+    csnActive = -1;
+    memset(pinLevel, 0, sizeof(pinLevel));
+    memset(gdoLevel, 0, sizeof(gdoLevel));
+    memset(isrs, 0, sizeof(isrs));
+}
+
+CC1101Sim& SimHost::addChip(uint8_t csn, uint8_t miso, uint8_t gdo0, uint8_t gdo2) {
+    chips.push_back(std::unique_ptr<CC1101Sim>(new CC1101Sim(*this, chips.size(), csn, miso, gdo0, gdo2)));
+    pinLevel[csn] = 1;
+    checkPins();
+    return *chips.back();
+}
+
+void SimHost::seed(uint32_t s) {
+    rng = s ? s : 1;
+}
+
+uint32_t SimHost::rand32() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+double SimHost::rand01() {
+    return rand32() / 4294967296.0;
+}
+
+void SimHost::advance(uint64_t ns) {
+    uint64_t target = t + ns;
+    for (;;) {
+        runIsrs();
+        if (target < t) target = t; // the interrupt took some time
+        CC1101Sim* next = NULL;
+        uint64_t when = target + 1;
+        for (size_t i = 0; i < chips.size(); i++) {
+            uint64_t e = chips[i]->nextEvent();
+            if (e < when) {
+                when = e;
+                next = chips[i].get();
+            }
+        }
+        if (!next) break;
+        if (when > t) t = when;
+        next->process(t);
+        checkPins();
+        pruneAir();
+    }
+    t = target;
+    runIsrs();
+}
+
+CC1101Sim* SimHost::selectedChip() {
+    for (size_t i = 0; i < chips.size(); i++) {
+        if (chips[i]->selected()) return chips[i].get();
+    }
+    return NULL;
+}
+
+void SimHost::pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin;
+    (void)mode;
+    bus.gpioCalls++;
+    advance(costs.pinModeNs);
+}
+
+void SimHost::pinWrite(uint8_t pin, uint8_t val, uint32_t costNs) {
+    bus.gpioCalls++;
+    advance(costNs ? costNs : costs.digitalWriteNs);
+    pinLevel[pin] = val;
+    for (size_t i = 0; i < chips.size(); i++) {
+        CC1101Sim& c = *chips[i];
+        if (c.csnPin != pin) continue;
+        bool was = c.selected();
+        c.csn(val != 0, t);
+        if (!was && c.selected()) {
+            csnActive = c.id;
+            SimTransaction tr;
+            tr.chip = c.id;
+            tr.start = tr.end = t;
+            if (logging) log.push_back(tr);
+            bus.busNs -= t;
+        } else if (was && !c.selected()) {
+            bus.transactions++;
+            bus.busNs += t;
+            if (logging && !log.empty()) log.back().end = t;
+            csnActive = -1;
+        }
+    }
+    checkPins();
+}
+
+int SimHost::pinRead(uint8_t pin, uint32_t costNs) {
+    bus.gpioCalls++;
+    advance(costNs ? costNs : costs.digitalReadNs);
+    for (size_t i = 0; i < chips.size(); i++) {
+        CC1101Sim& c = *chips[i];
+        if (c.gdo0Pin == pin) return c.gdoLevel(0, t);
+        if (c.gdo2Pin == pin) return c.gdoLevel(2, t);
+    }
+    CC1101Sim* c = selectedChip();
+    if (c && c->misoPin == pin) return c->misoLevel(t);
+    for (size_t i = 0; i < chips.size(); i++) {
+        if (chips[i]->misoPin == pin) return 1; // high impedance, pulled up
+    }
+    return pinLevel[pin];
+}
+
+uint8_t SimHost::spiTransfer(uint8_t b, uint64_t costNs) {
+    advance(costNs);
+    bus.bytes++;
+    CC1101Sim* c = selectedChip();
+    uint8_t r = c ? c->spiByte(b, t) : 0xFF;
+    if (logging && c && !log.empty() && csnActive == c->id) {
+        log.back().mosi.push_back(b);
+        log.back().miso.push_back(r);
+    }
+    checkPins();
+    return r;
+}
+
+void SimHost::attachIsr(uint8_t pin, void (*isr)(void), int mode) {
+    isrs[pin].fn = isr;
+    isrs[pin].mode = mode;
+    isrs[pin].pending = false;
+}
+
+void SimHost::detachIsr(uint8_t pin) {
+    isrs[pin].fn = NULL;
+    isrs[pin].pending = false;
+}
+
+void SimHost::setInterrupts(bool on) {
+    interruptsOn = on;
+    if (on) runIsrs();
+}
+
+void SimHost::checkPins() {
+    for (size_t i = 0; i < chips.size(); i++) {
+        CC1101Sim& c = *chips[i];
+        for (uint8_t g = 0; g <= 2; g += 2) {
+            uint8_t pin = g == 0 ? c.gdo0Pin : c.gdo2Pin;
+            if (pin == 0xFF) continue;
+            bool level = c.gdoLevel(g, t);
+            if (level == gdoLevel[pin]) continue;
+            gdoLevel[pin] = level;
+            Isr& isr = isrs[pin];
+            if (!isr.fn) continue;
+            // CHANGE=1 FALLING=2 RISING=3
+            if (isr.mode == 1 || (isr.mode == 3 && level) || (isr.mode == 2 && !level)) isr.pending = true;
+        }
+    }
+}
+
+void SimHost::runIsrs() {
+    if (!interruptsOn || inIsr) return;
+    bool again = true;
+    while (again) {
+        again = false;
+        for (int pin = 0; pin < 256; pin++) {
+            if (!isrs[pin].pending || !isrs[pin].fn) continue;
+            isrs[pin].pending = false;
+            inIsr = true;
+            isrs[pin].fn();
+            inIsr = false;
+            again = true;
+        }
+    }
+}
+
+void SimHost::pruneAir() {
+    for (size_t i = 0; i < frames.size();) {
+        if (frames[i]->end != NEVER && frames[i]->end + 1000000 < t) frames.erase(frames.begin() + i);
+        else i++;
+    }
+}
+
+void SimHost::frameStarted(const std::shared_ptr<SimFrame>& f) {
+    for (size_t i = 0; i < frames.size(); i++) {
+        SimFrame& g = *frames[i];
+        if (!g.active(f->start) || isnan(g.freqHz) || isnan(f->freqHz)) continue;
+        if (fabs(g.freqHz - f->freqHz) < 50000) g.corrupt = f->corrupt = true;
+    }
+    frames.push_back(f);
+    lastFrame = f;
+}
+
+int SimHost::rssiAt(const SimFrame& f, const CC1101Sim& rx) const {
+    (void)rx;
+    return f.rssiDbm;
+}
+
+int SimHost::levelAt(double freqHz, double bwHz, uint64_t now, int exclude) const {
+    int level = noiseFloorDbm;
+    for (size_t i = 0; i < frames.size(); i++) {
+        const SimFrame& f = *frames[i];
+        if (f.src == exclude || !f.active(now) || isnan(f.freqHz)) continue;
+        if (now < f.start + rssiDelayNs) continue;
+        if (fabs(f.freqHz - freqHz) < bwHz / 2) level = std::max(level, f.rssiDbm);
+    }
+    for (size_t i = 0; i < interferers.size(); i++) {
+        const Interferer& n = interferers[i];
+        if (now < n.from || now >= n.to) continue;
+        if (fabs(n.freqHz - freqHz) < (bwHz + n.bwHz) / 2) level = std::max(level, n.dbm);
+    }
+    return level;
+}
+
+void SimHost::addInterferer(double freqHz, double bwHz, int dbm, uint64_t from, uint64_t to) {
+    Interferer n = {freqHz, bwHz, dbm, from, to};
+    interferers.push_back(n);
+}
+
+void SimHost::injectPacket(const CC1101Sim& like, const uint8_t *payload, uint16_t len,
+    int rssiDbm, bool crcOk, uint64_t delayNs, uint64_t extraPreambleNs) {
+    std::shared_ptr<SimFrame> f(new SimFrame());
+    uint64_t bt = like.byteNs();
+    f->src = -1;
+    f->freqHz = like.carrierHz();
+    f->dataRate = like.dataRate();
+    f->sync = like.syncWord();
+    f->format = like.frameFormat();
+    f->rssiDbm = rssiDbm;
+    f->lqi = 2;
+    f->start = t + delayNs;
+    f->syncEnd = f->start + extraPreambleNs + (like.preambleBytes() + like.syncBytes()) * bt;
+    if ((like.reg(0x08) & 3) == 1) f->data.push_back((uint8_t)len);
+    f->data.insert(f->data.end(), payload, payload + len);
+    for (size_t i = 0; i < f->data.size(); i++) f->at.push_back(f->syncEnd + (i + 1) * bt);
+    f->crc = like.reg(0x08) & 0x04;
+    f->crcOk = crcOk;
+    f->dataDone = true;
+    f->corrupt = f->aborted = false;
+    f->end = f->at.back() + (f->crc ? 2 * bt : 0);
+    frameStarted(f);
+}
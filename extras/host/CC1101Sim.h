@@ -0,0 +1,337 @@
+/*
+Software model of the CC1101 chip, used by the host build of CC1101_RF.
+Licenced under MIT licence
+
+The model is fed by the host Arduino core (Arduino.h SPI.h). It implements
+the parts of the chip the library depends on:
+- register file, PATABLE, status registers and the chip status byte
+- the SPI protocol (header byte, single/burst access, strobes)
+- the MARCSTATE machine with calibration/settling times (SWRS061I table 34)
+- 64 byte RX/TX FIFOs, emptied/filled at the data rate
+- packet handling: preamble, sync word, variable/fixed/infinite length,
+  address check, appended status, CCA
+- Wake On Radio and power down, GDO0/GDO2 outputs
+Chips talk to each other over a shared "air" and packets can also be injected
+directly. Every SPI transaction is recorded and counted in SimBusStats.
+
+All times are in nanoseconds of a virtual clock owned by SimHost.
+*/
+
+#ifndef CC1101Sim_h
+#define CC1101Sim_h
+
+#include <stdint.h>
+#include <vector>
+#include <memory>
+
+class SimHost;
+
+// What a call into the Arduino core costs on the MCU. The defaults are
+// an ATmega328P @ 8MHz with the SPI bus at the default clock (F_CPU/4)
+struct SimCosts {
+	uint32_t digitalWriteNs;
+	uint32_t digitalReadNs;
+	uint32_t pinModeNs;
+	uint32_t portAccessNs;      // direct port register access (sbi cbi sbic), digitalWriteFast()
+	uint32_t timeCallNs;        // millis() micros()
+	uint32_t spiClockHz;
+	uint32_t spiByteCallNs;     // overhead of each transfer(byte) call
+	uint32_t spiBufferCallNs;   // overhead of each transfer(buf, n) call
+	uint32_t spiBufferByteNs;   // gap between the bytes of transfer(buf, n)
+	uint32_t spiTransactionNs;  // beginTransaction() + endTransaction()
+	uint32_t mcuHz;             // the SPI clock is F_CPU/2^n
+	SimCosts();
+	// The clock the SPI peripheral actually uses for a requested clock
+	uint32_t spiClockFor(uint32_t requested) const;
+	uint64_t spiBitsNs(uint32_t bits) const;
+};
+
+// Bus counters, since the last reset()
+struct SimBusStats {
+	uint32_t transactions;      // CSn low->high cycles
+	uint32_t bytes;             // all bytes clocked, headers included
+	uint32_t headers;
+	uint32_t strobes;           // SNOP included
+	uint32_t snops;             // status polls
+	uint32_t gpioCalls;         // digitalRead/digitalWrite/pinMode
+	uint64_t busNs;             // time with CSn low
+	void reset();
+};
+
+// A CSn low->high cycle
+struct SimTransaction {
+	uint8_t chip;
+	uint64_t start, end;
+	std::vector<uint8_t> mosi;
+	std::vector<uint8_t> miso;
+};
+
+// A packet on the air, sent by a CC1101Sim or injected
+struct SimFrame {
+	int src;                    // chip id, -1 for injected frames
+	double freqHz;
+	double dataRate;            // bits/sec
+	uint32_t sync;              // sync bytes<<16 | SYNC1<<8 | SYNC0
+	uint8_t format;             // whitening, manchester, MOD_FORMAT
+	int rssiDbm;                // only for injected frames
+	uint8_t lqi;
+	uint64_t start;             // preamble starts
+	uint64_t syncEnd;           // ~0 while the preamble is still sent
+	uint64_t end;               // ~0 while the frame is on air
+	std::vector<uint8_t> data;  // length byte (if any) + payload
+	std::vector<uint64_t> at;   // arrival time of every data byte
+	bool dataDone;              // all data bytes are sent, CRC follows
+	bool crc;                   // the CRC was calculated by the transmitter
+	bool crcOk;
+	bool corrupt;               // collision
+	bool aborted;               // TX FIFO underflow, SIDLE
+	bool active(uint64_t t) const { return start<=t && t<end; }
+};
+
+class CC1101Sim {
+	public:
+		// MARCSTATE values (SWRS061I page 93) used by the model
+		enum {
+			M_SLEEP=0, M_IDLE=1, M_XOFF=2, M_STARTCAL=8, M_FS_LOCK=10, M_RX=13,
+			M_TXRX_SWITCH=16, M_RXFIFO_OVERFLOW=17, M_FSTXON=18, M_TX=19,
+			M_RXTX_SWITCH=21, M_TXFIFO_UNDERFLOW=22
+		};
+		// Time in state classes, see stateNs()
+		enum { T_SLEEP, T_IDLE, T_RX, T_TX, T_OTHER, T_COUNT };
+
+		CC1101Sim(SimHost& host, uint8_t id, uint8_t csn, uint8_t miso, uint8_t gdo0, uint8_t gdo2);
+
+		// pins
+		const uint8_t id;
+		const uint8_t csnPin;
+		const uint8_t misoPin;
+		const uint8_t gdo0Pin;
+		const uint8_t gdo2Pin;
+
+		// Driven by the host core
+		void csn(bool level, uint64_t now);
+		bool selected() const { return isSelected; }
+		bool misoLevel(uint64_t now) const;
+		bool gdoLevel(uint8_t gdo, uint64_t now) const;
+		uint8_t spiByte(uint8_t mosi, uint64_t now);
+		uint64_t nextEvent() const;
+		void process(uint64_t now);
+
+		// Inspection, no side effects
+		uint8_t reg(uint8_t addr) const { return regs[addr]; }
+		uint8_t patable(uint8_t i) const { return pa[i & 7]; }
+		uint8_t marcState() const { return ms; }
+		uint8_t statusState() const;
+		uint8_t rxFifoBytes() const { return (uint8_t)rxFifo.size(); }
+		uint8_t txFifoBytes() const { return (uint8_t)txFifo.size(); }
+		bool wor() const { return worOn; }
+		double carrierHz() const;
+		double channelBwHz() const;
+		double dataRate() const;       // bits/sec
+		uint32_t byteNs() const;       // air time of one byte
+		uint32_t rssiPeriodNs() const; // RSSI update, 8*2^FILTER_LENGTH/(2*BWchannel)
+		bool synthLocked() const;
+		int channelRssi(uint64_t now) const;
+		bool carrierSense(uint64_t now) const;
+		uint64_t stateNs(uint8_t t, uint64_t now) const;
+		bool ready(uint64_t now) const { return now>=readyAt; }
+		uint32_t preambleBytes() const;
+		uint32_t syncBytes() const;
+		uint32_t syncWord() const;
+		uint8_t frameFormat() const;
+
+		// Chip events since the chip was created
+		uint32_t calibrations;
+		uint32_t framesSent;
+		uint32_t framesReceived;       // status bytes appended (CRC ok or not)
+		uint32_t framesDiscarded;      // length/address filter
+		uint32_t rxOverflows;
+		uint32_t txUnderflows;
+		uint32_t wakeups;              // WOR EVENT0
+
+		// RSSI of the frames this chip sends, as seen by the others
+		int txRssiDbm;
+		// LQI reported for the frames this chip sends
+		uint8_t txLqi;
+
+	private:
+		SimHost& host;
+		uint8_t regs[0x2F];
+		uint8_t pa[8];
+		uint8_t paIndex;
+		std::vector<uint8_t> rxFifo;
+		std::vector<uint8_t> txFifo;
+		bool rxUnderOverflow;
+		bool txUnderflow;
+
+		// SPI
+		bool isSelected;
+		bool expectHeader;
+		uint8_t spiAddr;
+		bool spiRead;
+		bool spiBurst;
+		bool pendingPowerDown;
+		bool pendingXoff;
+		uint64_t readyAt;              // crystal running and reset finished
+
+		// state machine
+		uint8_t ms;
+		uint64_t transAt;              // 0 = no pending transition
+		uint8_t transGoal;
+		uint8_t autoIdleCount;         // FS_AUTOCAL=3
+		uint64_t stateSince;
+		uint64_t stateAcc[T_COUNT];
+
+		// TX
+		enum { TX_PREAMBLE, TX_SYNC, TX_DATA, TX_CRC };
+		uint8_t txPhase;
+		uint64_t txNext;
+		uint16_t txCount;
+		uint16_t txTotal;              // 0 = unknown yet
+		bool txByteInFlight;
+		uint8_t txByte;
+		std::shared_ptr<SimFrame> txFrame;
+
+		// RX
+		uint64_t rxSince;              // when the receiver started listening
+		uint64_t rxScanFrom;           // frames with syncEnd before this are ignored
+		std::shared_ptr<SimFrame> rxFrame;
+		bool rxFrameBad;
+		uint16_t rxIdx;
+		uint16_t rxTotal;              // 0 = unknown yet
+		uint16_t rxPushed;             // bytes of the current packet in the FIFO
+		uint64_t rxStatusAt;           // 0 = not waiting for the CRC
+		bool pktCrcOkFlag;             // GDO 0x07
+		uint8_t lastRssi;
+		uint8_t lastLqi;
+		bool rxPktEnd;                 // GDO 0x01, until the RX FIFO is empty
+
+		// WOR
+		bool worOn;
+		uint64_t worStart;
+		uint64_t worNext;              // next EVENT0
+		uint64_t worRxAt;              // RX starts after EVENT1
+		uint64_t worTimeoutAt;         // 0 = no timeout
+		uint64_t worRssiCheckAt;
+		bool worRx;                    // RX started by WOR
+
+		void resetChip(uint64_t now);
+		void setState(uint8_t s, uint64_t now);
+		uint8_t statusByte(bool read) const;
+		uint8_t readStatusReg(uint8_t addr, uint64_t now);
+		void writeReg(uint8_t addr, uint8_t value);
+		void execStrobe(uint8_t s, uint64_t now);
+		void startTransition(uint8_t goal, uint64_t now);
+		void afterPacket(uint8_t offMode, uint64_t now);
+		void goIdleAuto(uint64_t now);
+		void calibrate();
+		void reachGoal(uint8_t goal, uint64_t now);
+		void enterRX(uint64_t now);
+		void enterTX(uint64_t now);
+		void abortTX(uint64_t now);
+		void abortRX(uint64_t now);
+		void processTX(uint64_t now);
+		void processRX(uint64_t now);
+		void processWOR(uint64_t now);
+		uint64_t rxNextEvent() const;
+		bool frameMatches(const SimFrame& f) const;
+		bool rxPush(uint8_t b, uint64_t now);
+		void rxDiscard();
+		void rxFinish(uint64_t now);
+		uint64_t worEvent0Ns() const;
+		void worSleep(uint64_t now);
+		uint8_t stateClass() const;
+		bool isRx() const { return ms==M_RX; }
+		bool lengthDone(uint16_t count, uint16_t first) const;
+};
+
+// The virtual clock, the pins, the SPI bus and the air.
+class SimHost {
+	public:
+		static SimHost& get();
+
+		// Removes the chips and resets the clock/counters. Keeps the costs.
+		void reset();
+		// A CC1101 module. The MISO pin may be shared, CSN must be unique.
+		// Use 0xFF for GDO pins not connected to the MCU.
+		CC1101Sim& addChip(uint8_t csn, uint8_t miso, uint8_t gdo0=0xFF, uint8_t gdo2=0xFF);
+		CC1101Sim& chip(uint8_t id) { return *chips[id]; }
+		size_t chipCount() const { return chips.size(); }
+
+		uint64_t now() const { return t; }
+		// Runs the chips for ns nanoseconds. Interrupts are served on time.
+		void advance(uint64_t ns);
+
+		SimCosts costs;
+		SimBusStats bus;
+
+		// Transactions are recorded while true (the default)
+		bool logging;
+		std::vector<SimTransaction> log;
+
+		// Air
+		// received power of chip->chip frames, unless set per chip (txRssiDbm)
+		int noiseFloorDbm;
+		int ccaThresholdDbm;
+		// The RSSI (and so the CCA) of a receiver follows a new frame after this time.
+		// 0 : immediately, a real chip needs some bit times (the channel filter and AGC)
+		uint64_t rssiDelayNs;
+		// probability that a frame is not detected at all by a receiver
+		double lossRate;
+		// probability that a frame is received with a bad CRC
+		double corruptRate;
+		// The last frame on the air. Kept after the frame is removed from air()
+		std::shared_ptr<SimFrame> lastFrame;
+		// A narrow band interferer (another system, noise, a jammer)
+		void addInterferer(double freqHz, double bwHz, int dbm, uint64_t from=0, uint64_t to=~0ull);
+		void clearInterferers() { interferers.clear(); }
+		// Sends a packet on the channel the chip is tuned. The length byte is added
+		// if the chip is configured for variable length packets.
+		// extraPreambleNs is the preamble beyond the configured one (WOR wake up)
+		void injectPacket(const CC1101Sim& like, const uint8_t *payload, uint16_t len,
+			int rssiDbm=-60, bool crcOk=true, uint64_t delayNs=0, uint64_t extraPreambleNs=0);
+
+		// Deterministic random numbers for the air and for random()
+		void seed(uint32_t s);
+		uint32_t rand32();
+		double rand01();
+
+		// Used by the host core
+		void pinMode(uint8_t pin, uint8_t mode);
+		// costNs=0 : the cost of digitalWrite() digitalRead()
+		void pinWrite(uint8_t pin, uint8_t val, uint32_t costNs=0);
+		int pinRead(uint8_t pin, uint32_t costNs=0);
+		uint8_t spiTransfer(uint8_t b, uint64_t costNs);
+		void attachIsr(uint8_t pin, void (*isr)(void), int mode);
+		void detachIsr(uint8_t pin);
+		void setInterrupts(bool on);
+		bool interruptsEnabled() const { return interruptsOn; }
+
+		// Used by the chips
+		std::vector<std::shared_ptr<SimFrame> >& air() { return frames; }
+		void frameStarted(const std::shared_ptr<SimFrame>& f);
+		int rssiAt(const SimFrame& f, const CC1101Sim& rx) const;
+		int levelAt(double freqHz, double bwHz, uint64_t now, int exclude) const;
+
+	private:
+		SimHost();
+		struct Interferer { double freqHz, bwHz; int dbm; uint64_t from, to; };
+		struct Isr { void (*fn)(void); int mode; bool pending; };
+		uint64_t t;
+		uint32_t rng;
+		std::vector<std::unique_ptr<CC1101Sim> > chips;
+		std::vector<std::shared_ptr<SimFrame> > frames;
+		std::vector<Interferer> interferers;
+		uint8_t pinLevel[256];
+		bool gdoLevel[256];
+		Isr isrs[256];
+		bool interruptsOn;
+		bool inIsr;
+		int csnActive;
+		void checkPins();
+		void runIsrs();
+		void pruneAir();
+		CC1101Sim* selectedChip();
+};
+
+#endif
@@ -0,0 +1,137 @@
+/*
+Host (Linux) Arduino core, backed by SimHost
+Licenced under MIT licence
+*/
+
+#include "Arduino.h"
+#include "SPI.h"
+#include "CC1101Sim.h"
+
+SPIClass SPI;
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    SimHost::get().pinMode(pin, mode);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    SimHost::get().pinWrite(pin, val);
+}
+
+int digitalRead(uint8_t pin) {
+    return SimHost::get().pinRead(pin);
+}
+
+void digitalWriteFast(uint8_t pin, uint8_t val) {
+    SimHost& host = SimHost::get();
+    host.pinWrite(pin, val, host.costs.portAccessNs);
+}
+
+int digitalReadFast(uint8_t pin) {
+    SimHost& host = SimHost::get();
+    return host.pinRead(pin, host.costs.portAccessNs);
+}
+
+unsigned long millis(void) {
+    SimHost& host = SimHost::get();
+    host.advance(host.costs.timeCallNs);
+    return (unsigned long)(host.now() / 1000000);
+}
+
+unsigned long micros(void) {
+    SimHost& host = SimHost::get();
+    host.advance(host.costs.timeCallNs);
+    return (unsigned long)(host.now() / 1000);
+}
+
+void delay(unsigned long ms) {
+    SimHost::get().advance((uint64_t)ms * 1000000);
+}
+
+void delayMicroseconds(unsigned int us) {
+    SimHost::get().advance((uint64_t)us * 1000);
+}
+
+void attachInterrupt(uint8_t interruptNum, void (*isr)(void), int mode) {
+    SimHost::get().attachIsr(interruptNum, isr, mode);
+}
+
+void detachInterrupt(uint8_t interruptNum) {
+    SimHost::get().detachIsr(interruptNum);
+}
+
+void noInterrupts(void) {
+    SimHost::get().setInterrupts(false);
+}
+
+void interrupts(void) {
+    SimHost::get().setInterrupts(true);
+}
+
+long random(long howbig) {
+    if (howbig <= 0) return 0;
+    return SimHost::get().rand32() % howbig;
+}
+
+long random(long howsmall, long howbig) {
+    if (howsmall >= howbig) return howsmall;
+    return howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed) {
+    SimHost::get().seed(seed);
+}
+
+void SPIClass::usingInterrupt(uint8_t interruptNumber) {
+    interruptMask[interruptNumber] = true;
+}
+
+void SPIClass::notUsingInterrupt(uint8_t interruptNumber) {
+    interruptMask[interruptNumber] = false;
+}
+
+uint16_t SPIClass::interruptUsers() const {
+    uint16_t n = 0;
+    for (int i = 0; i < 256; i++) n += interruptMask[i];
+    return n;
+}
+
+// The model has one interrupt enable, a registered interrupt holds all of them (AVR
+// does the same for interrupts it cannot mask one by one)
+void SPIClass::beginTransaction(SPISettings settings) {
+    SimHost& host = SimHost::get();
+    if (interruptUsers() && host.interruptsEnabled()) {
+        host.setInterrupts(false);
+        masked = true;
+    }
+    host.costs.spiClockHz = host.costs.spiClockFor(settings.clock);
+    host.advance(host.costs.spiTransactionNs);
+}
+
+void SPIClass::endTransaction() {
+    if (masked) {
+        masked = false;
+        SimHost::get().setInterrupts(true);
+    }
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+    SimHost& host = SimHost::get();
+    return host.spiTransfer(data, host.costs.spiByteCallNs + host.costs.spiBitsNs(8));
+}
+
+void SPIClass::transfer(void *buf, size_t count) {
+    SimHost& host = SimHost::get();
+    uint8_t *p = (uint8_t*)buf;
+    host.advance(host.costs.spiBufferCallNs);
+    for (size_t i = 0; i < count; i++) {
+        p[i] = host.spiTransfer(p[i], host.costs.spiBufferByteNs + host.costs.spiBitsNs(8));
+    }
+}
+
+void SPIClass::writeBytes(const uint8_t *data, uint32_t size) {
+    SimHost& host = SimHost::get();
+    host.advance(host.costs.spiBufferCallNs);
+    for (uint32_t i = 0; i < size; i++) {
+        host.spiTransfer(data[i], host.costs.spiBufferByteNs + host.costs.spiBitsNs(8));
+    }
+}
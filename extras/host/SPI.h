@@ -0,0 +1,59 @@
+/*
+Host (Linux) replacement of the Arduino SPI library.
+Licenced under MIT licence
+
+The bytes go to the CC1101 model whose CSN pin is LOW. The API is the
+common subset of the AVR, STM32 and ESP8266 cores.
+*/
+
+#ifndef HOST_SPI_h
+#define HOST_SPI_h
+
+#include "Arduino.h"
+
+// the transaction API and notUsingInterrupt() of the AVR core
+#define SPI_HAS_TRANSACTION 1
+#define SPI_HAS_NOTUSINGINTERRUPT 1
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+class SPISettings {
+	public:
+		SPISettings(uint32_t clock=4000000, uint8_t bitOrder=MSBFIRST, uint8_t dataMode=SPI_MODE0)
+		: clock(clock), bitOrder(bitOrder), dataMode(dataMode) {}
+		uint32_t clock;
+		uint8_t bitOrder;
+		uint8_t dataMode;
+};
+
+class SPIClass {
+	public:
+		void begin() {}
+		void end() {}
+		void beginTransaction(SPISettings settings);
+		void endTransaction();
+		// As the AVR core : the registered interrupts wait until the end of every transaction
+		void usingInterrupt(uint8_t interruptNumber);
+		void notUsingInterrupt(uint8_t interruptNumber);
+		uint16_t interruptUsers() const;
+
+		uint8_t transfer(uint8_t data);
+		// in place, the received bytes replace the sent ones
+		void transfer(void *buf, size_t count);
+		// ESP8266/ESP32 style write only burst
+		void writeBytes(const uint8_t *data, uint32_t size);
+
+	private:
+		bool interruptMask[256];
+		bool masked; // the interrupts were on at beginTransaction()
+};
+
+extern SPIClass SPI;
+
+#endif
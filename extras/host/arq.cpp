@@ -0,0 +1,144 @@
+/*
+Goodput of CC1101Arq on the CC1101 model. Module A sends 200 messages of 57 bytes to
+module B at 250kbps, the model loses a part of the frames (SimHost::lossRate, the ACKs
+included). window=1 is stop-and-wait, the larger windows send the messages back to back
+with sendBatch() and one ACK per burst. B receives with the GDO0 interrupt, A with
+enableMultiPacketRx(). The program fails if a message is lost, duplicated or reordered.
+Then A restarts with the same randomSeed() (a node without an entropy source) and sends 3
+more messages, B must deliver them.
+Licenced under MIT licence
+
+One CSV line per window and loss rate :
+window,loss,messages,delivered,seconds,goodput_bps,efficiency,frames,retransmissions,timeouts,acks
+goodput_bps : the payload bits delivered to B per second, efficiency = goodput_bps/data rate
+*/
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <CC1101_RF.h>
+#include <CC1101_Arq.h>
+#include "CC1101Sim.h"
+
+static const int MESSAGES = 200;
+static const uint32_t RATE = 250000;
+static int delivered;
+static bool wrong;
+
+static void received(byte src, const byte *data, byte size) {
+    (void)src;
+    // the messages are numbered
+    if (size != CC1101_ARQ_MAX_PAYLOAD || data[0] != (delivered & 0xFF) || data[1] != (delivered >> 8)) wrong = true;
+    delivered++;
+}
+
+template <byte WINDOW> static bool run(double loss) {
+    SimHost& host = SimHost::get();
+    host.reset();
+    host.logging = false;
+    host.addChip(10, MISO, 2);
+    host.addChip(9, MISO, 3);
+    CC1101 radioA(10);
+    CC1101 radioB(9);
+    radioA.begin(433.2e6);
+    radioB.begin(433.2e6);
+    uint32_t actual = radioA.setDataRate(RATE);
+    radioB.setDataRate(RATE);
+    static CC1101RxQueue<CC1101_ARQ_MAX_WINDOW + 1> queue;
+    radioB.enableRxInterrupt(3, queue);
+    CC1101Arq<WINDOW, 1> a(radioA, 0x10);
+    CC1101Arq<WINDOW, 1> b(radioB, 0x20);
+    a.begin(NULL);
+    b.begin(received);
+    host.lossRate = loss;
+    delivered = 0;
+    wrong = false;
+
+    byte message[CC1101_ARQ_MAX_PAYLOAD];
+    for (byte i = 0; i < sizeof(message); i++) message[i] = i;
+    int queued = 0;
+    uint64_t t0 = host.now();
+    while ((queued < MESSAGES || a.pending()) && host.now() - t0 < 60000000000ull) {
+        while (queued < MESSAGES) {
+            message[0] = queued & 0xFF;
+            message[1] = queued >> 8;
+            if (!a.send(0x20, message, sizeof(message))) break;
+            queued++;
+        }
+        a.update();
+        b.update();
+    }
+    double seconds = (host.now() - t0) / 1e9;
+    double goodput = delivered * CC1101_ARQ_MAX_PAYLOAD * 8 / seconds;
+    printf("%u,%.2f,%d,%d,%.3f,%.0f,%.2f,%lu,%lu,%u,%lu\n", WINDOW, loss, MESSAGES, delivered, seconds,
+        goodput, goodput / actual, (unsigned long)a.framesSent, (unsigned long)a.retransmissions, a.timeouts,
+        (unsigned long)b.acksSent);
+    radioB.disableRxInterrupt();
+    return delivered == MESSAGES && !wrong && a.failures == 0;
+}
+
+// A sends 10 messages, restarts (a new link, the same random() sequence) and sends 3 more.
+// B remembers the sequence of the old A.
+static bool reboot() {
+    SimHost& host = SimHost::get();
+    host.reset();
+    host.logging = false;
+    host.addChip(10, MISO, 2);
+    host.addChip(9, MISO, 3);
+    CC1101 radioA(10);
+    CC1101 radioB(9);
+    radioA.begin(433.2e6);
+    radioB.begin(433.2e6);
+    radioA.setDataRate(RATE);
+    radioB.setDataRate(RATE);
+    static CC1101RxQueue<CC1101_ARQ_MAX_WINDOW + 1> queue;
+    radioB.enableRxInterrupt(3, queue);
+    CC1101Arq<4, 1> b(radioB, 0x20);
+    b.begin(received);
+    host.lossRate = 0;
+    delivered = 0;
+    wrong = false;
+    byte message[CC1101_ARQ_MAX_PAYLOAD];
+    for (byte i = 0; i < sizeof(message); i++) message[i] = i;
+    int sent = 0;
+    for (int boot = 0; boot < 2; boot++) {
+        randomSeed(1);
+        CC1101Arq<4, 1> a(radioA, 0x10);
+        a.begin(NULL);
+        int n = boot == 0 ? 10 : 3;
+        uint64_t t0 = host.now();
+        for (int i = 0; (i < n || a.pending()) && host.now() - t0 < 1000000000ull;) {
+            if (i < n) {
+                message[0] = sent & 0xFF;
+                message[1] = sent >> 8;
+                if (a.send(0x20, message, sizeof(message))) {
+                    i++;
+                    sent++;
+                }
+            }
+            a.update();
+            b.update();
+        }
+        // the last ACK
+        for (int i = 0; i < 20; i++) {
+            delay(1);
+            b.update();
+        }
+    }
+    printf("# restart with the same randomSeed() : %d messages, %d delivered%s\n", sent, delivered,
+        wrong ? ", wrong order" : "");
+    radioB.disableRxInterrupt();
+    return delivered == sent && !wrong;
+}
+
+int main() {
+    static const double losses[] = {0, 0.05, 0.1, 0.2};
+    printf("window,loss,messages,delivered,seconds,goodput_bps,efficiency,frames,retransmissions,timeouts,acks\n");
+    int failures = 0;
+    for (size_t l = 0; l < sizeof(losses) / sizeof(losses[0]); l++) {
+        if (!run<1>(losses[l])) failures++;
+        if (!run<4>(losses[l])) failures++;
+        if (!run<8>(losses[l])) failures++;
+    }
+    if (!reboot()) failures++;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,272 @@
+/*
+SPI cost of the public functions of class CC1101, measured on the CC1101 model.
+Licenced under MIT licence
+
+For every function and SPI clock one CSV line is printed :
+spi_hz,method,cs,bytes,snops,bus_us,total_us
+cs       chip select cycles (SPI transactions)
+bytes    bytes clocked on the bus, headers included
+snops    SNOP strobes (status polls)
+bus_us   time with CSn low
+total_us time the MCU spends inside the call (air time included for sendPacket)
+
+The output can be saved and compared between releases :
+./build/cc1101_bench > before.csv
+*/
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <CC1101_RF.h>
+#include "CC1101Sim.h"
+#include <type_traits>
+
+static SimHost& host = SimHost::get();
+static uint32_t spiHz;
+
+// A fresh module, after begin() and in RX state, unless raw=true.
+template <class Radio> struct BenchOf {
+    CC1101Sim* chip;
+    Radio* radio;
+    BenchOf(bool raw=false) {
+        host.reset();
+        host.logging = false;
+        host.costs.spiClockHz = spiHz;
+        chip = &host.addChip(SS, MISO, 2);
+        radio = new Radio(spiHz);
+        if (!raw) {
+            radio->begin(433.2e6);
+            radio->setRXstate();
+        }
+    }
+    ~BenchOf() {
+        delete radio;
+    }
+};
+
+// The pin access is a template policy, not virtual functions
+static_assert(!std::is_polymorphic<CC1101>::value, "CC1101 has no vtable");
+
+// CC1101 with the SPI clock as the only argument, as CC1101T
+struct SlowRadio : public CC1101 {
+    SlowRadio(uint32_t spiHz) : CC1101(SS, MISO, SPI, spiHz) {}
+};
+typedef BenchOf<SlowRadio> Bench;
+// CC1101T with compile time pins
+typedef BenchOf< CC1101T<SS, MISO, SPI> > FastBench;
+
+static void print(const char* method, const SimBusStats& bus, uint64_t ns) {
+    printf("%lu,%s,%u,%u,%u,%.1f,%.1f\n", (unsigned long)spiHz, method, bus.transactions,
+        bus.bytes, bus.snops, bus.busNs / 1000.0, ns / 1000.0);
+}
+
+template <class F> static void measure(const char* method, F fn) {
+    host.bus.reset();
+    uint64_t t0 = host.now();
+    fn();
+    print(method, host.bus, host.now() - t0);
+}
+
+// Only the largest SPI transaction of fn (the FIFO burst)
+template <class F> static void largest(const char* method, F fn) {
+    host.log.clear();
+    host.logging = true;
+    fn();
+    host.logging = false;
+    SimBusStats bus = SimBusStats();
+    uint64_t ns = 0;
+    for (size_t i = 0; i < host.log.size(); i++) {
+        const SimTransaction& t = host.log[i];
+        if (t.mosi.size() <= bus.bytes) continue;
+        bus.transactions = 1;
+        bus.bytes = t.mosi.size();
+        bus.busNs = ns = t.end - t.start;
+    }
+    print(method, bus, ns);
+}
+
+// A packet waiting in the RX FIFO
+template <class B> static void receive(B& b, byte size) {
+    byte payload[MAX_PACKET_LEN];
+    for (byte i = 0; i < size; i++) payload[i] = i;
+    host.injectPacket(*b.chip, payload, size);
+    delay(200);
+}
+
+static void runAll() {
+    { Bench b(true); measure("begin", [&]{ b.radio->begin(433.2e6); }); }
+    { Bench b(true); measure("begin<Profile>", [&]{ b.radio->begin< CC1101Profile<433200000ul> >(); }); }
+    { Bench b; b.radio->setIDLEstate(); measure("setRXstate", [&]{ b.radio->setRXstate(); }); }
+    { Bench b; measure("setIDLEstate", [&]{ b.radio->setIDLEstate(); }); }
+    { Bench b; measure("getState", [&]{ b.radio->getState(); }); }
+    { Bench b; measure("readRegister", [&]{ b.radio->readRegister(CC1101_MDMCFG2); }); }
+    { Bench b; measure("strobe", [&]{ b.radio->strobe(CC1101_SNOP); }); }
+    {
+        // the payload copy alone, MCU<->FIFO
+        Bench b;
+        byte pkt[MAX_PACKET_LEN] = {0};
+        largest("payload copy(TX 61 bytes)", [&]{ b.radio->sendPacket(pkt, MAX_PACKET_LEN); });
+        receive(b, MAX_PACKET_LEN);
+        largest("payload copy(RX 61 bytes)", [&]{ b.radio->getPacket(pkt); });
+    }
+    {
+        Bench b;
+        byte pkt[64];
+        measure("getPacket(empty)", [&]{ b.radio->getPacket(pkt); });
+    }
+    {
+        Bench b;
+        byte pkt[64];
+        receive(b, 1);
+        measure("getPacket(1 byte)", [&]{ b.radio->getPacket(pkt); });
+    }
+    {
+        Bench b;
+        byte pkt[64];
+        receive(b, MAX_PACKET_LEN);
+        measure("getPacket(61 bytes)", [&]{ b.radio->getPacket(pkt); });
+    }
+    {
+        Bench b;
+        byte pkt[64];
+        b.radio->enableMultiPacketRx();
+        b.radio->setRXstate();
+        measure("getPacket(multi, empty)", [&]{ b.radio->getPacket(pkt); });
+        receive(b, 1);
+        measure("getPacket(multi, 1 byte)", [&]{ b.radio->getPacket(pkt); });
+        receive(b, MAX_PACKET_LEN);
+        measure("getPacket(multi, 61 bytes)", [&]{ b.radio->getPacket(pkt); });
+    }
+    {
+        // interrupt reception, the packet is already in the queue
+        Bench b;
+        CC1101RxQueue<3> queue;
+        byte pkt[64];
+        b.radio->enableRxInterrupt(2, queue);
+        receive(b, MAX_PACKET_LEN);
+        measure("available()", [&]{ b.radio->available(); });
+        measure("read(61 bytes)", [&]{ b.radio->read(pkt); });
+        b.radio->disableRxInterrupt();
+    }
+    {
+        Bench b;
+        byte pkt[MAX_PACKET_LEN] = {0};
+        measure("sendPacket(1 byte)", [&]{ b.radio->sendPacket(pkt, 1); });
+        measure("sendPacket(61 bytes)", [&]{ b.radio->sendPacket(pkt, MAX_PACKET_LEN); });
+        measure("sendPacket(1 byte 100ms)", [&]{ b.radio->sendPacket(pkt, 1, 100); });
+        measure("sendPacket(char*)", [&]{ b.radio->sendPacket("Hello world!"); });
+        measure("sendPacketSlowMCU(61 bytes)", [&]{ b.radio->sendPacketSlowMCU(pkt, MAX_PACKET_LEN); });
+        measure("printf", [&]{ b.radio->printf("millis()=%lu", 123456ul); });
+    }
+    {
+        // TXOFF_MODE=RX, no calibration after the packet
+        Bench b;
+        byte pkt[MAX_PACKET_LEN] = {0};
+        b.radio->enableFastTurnaround(0);
+        b.radio->setRXstate();
+        measure("sendPacket(61 bytes fast turnaround)", [&]{ b.radio->sendPacket(pkt, MAX_PACKET_LEN); });
+    }
+    {
+        // beginSend() and poll() from a loop() with 1ms of other work. The loop()
+        // is blocked at most for the worst poll()
+        Bench b;
+        byte pkt[MAX_PACKET_LEN] = {0};
+        measure("beginSend(61 bytes)", [&]{ b.radio->beginSend(pkt, MAX_PACKET_LEN); });
+        SimBusStats worstBus = SimBusStats();
+        uint64_t worst = 0;
+        do {
+            delay(1);
+            host.bus.reset();
+            uint64_t t0 = host.now();
+            b.radio->poll();
+            if (host.now() - t0 > worst) {
+                worst = host.now() - t0;
+                worstBus = host.bus;
+            }
+        } while (b.radio->sendStatus() == CC1101_SEND_PENDING);
+        print("poll(worst)", worstBus, worst);
+    }
+    {
+        Bench b;
+        byte pkt[255] = {0};
+        b.radio->enableLongPackets();
+        b.radio->setRXstate();
+        measure("sendLongPacket(255 bytes)", [&]{ b.radio->sendLongPacket(pkt, 255); });
+    }
+    {
+        // the channel is busy, CCA blocks the transmission
+        Bench b;
+        host.addInterferer(433.2e6, 50e3, -50);
+        byte pkt[1] = {0};
+        measure("sendPacket(busy channel)", [&]{ b.radio->sendPacket(pkt, 1); });
+    }
+    // the same functions with CC1101T
+    { FastBench b(true); measure("CC1101T begin", [&]{ b.radio->begin(433.2e6); }); }
+    { FastBench b; b.radio->setIDLEstate(); measure("CC1101T setRXstate", [&]{ b.radio->setRXstate(); }); }
+    { FastBench b; measure("CC1101T readRegister", [&]{ b.radio->readRegister(CC1101_MDMCFG2); }); }
+    {
+        FastBench b;
+        byte pkt[64];
+        receive(b, MAX_PACKET_LEN);
+        measure("CC1101T getPacket(61 bytes)", [&]{ b.radio->getPacket(pkt); });
+    }
+    { FastBench b; measure("CC1101T setFrequency", [&]{ b.radio->setFrequency(868.3e6); }); }
+    { Bench b; measure("setBaudrate4800bps", [&]{ b.radio->setBaudrate4800bps(); }); }
+    { Bench b; measure("setBaudrate38000bps", [&]{ b.radio->setBaudrate38000bps(); }); }
+    { Bench b; measure("setDataRate(250000)", [&]{ b.radio->setDataRate(250000); }); }
+    { Bench b; measure("setPower10dbm", [&]{ b.radio->setPower10dbm(); }); }
+    { Bench b; measure("setPower5dbm", [&]{ b.radio->setPower5dbm(); }); }
+    { Bench b; measure("setPower0dbm", [&]{ b.radio->setPower0dbm(); }); }
+    { Bench b; measure("setFrequency", [&]{ b.radio->setFrequency(868.3e6); }); }
+    {
+        // hop latency, from RX on one channel to RX on the next
+        Bench b;
+        static CC1101ChannelCal cal[16];
+        measure("setChannelPlan", [&]{ b.radio->setChannelPlan(433.2e6, 200000); });
+        b.radio->setRXstate();
+        measure("hop(autocal)", [&]{ b.radio->setChannel(3); b.radio->setRXstate(); });
+        measure("calibrateChannels(16)", [&]{ b.radio->calibrateChannels(cal, 16); });
+        b.radio->setRXstate();
+        measure("hop(cached calibration)", [&]{ b.radio->setChannel(7); b.radio->setRXstate(); });
+        int16_t dbm[16];
+        measure("scanChannels(16, cached calibration)", [&]{ b.radio->scanChannels(0, 16, dbm); });
+        b.radio->disableChannelCal();
+        b.radio->setRXstate();
+        measure("scanChannels(16, autocal)", [&]{ b.radio->scanChannels(0, 16, dbm); });
+    }
+    { Bench b; measure("enableAddressCheck", [&]{ b.radio->enableAddressCheck(3); }); }
+    { Bench b; measure("enableAddressCheckBcast", [&]{ b.radio->enableAddressCheckBcast(3); }); }
+    { Bench b; measure("disableAddressCheck", [&]{ b.radio->disableAddressCheck(); }); }
+    { Bench b; b.radio->enableAddressCheck(3); measure("enableAddressCheck(same)", [&]{ b.radio->enableAddressCheck(3); }); }
+    {
+        // a gateway talking to another peer, deferred mode
+        Bench b;
+        b.radio->deferWrites(true);
+        measure("apply(address+power)", [&]{
+            b.radio->enableAddressCheck(7);
+            b.radio->setPower0dbm();
+            b.radio->apply();
+        });
+        measure("apply(no change)", [&]{
+            b.radio->enableAddressCheck(7);
+            b.radio->setPower0dbm();
+            b.radio->apply();
+        });
+    }
+    { Bench b; measure("enableWhitening", [&]{ b.radio->enableWhitening(); }); }
+    { Bench b; measure("disableWhitening", [&]{ b.radio->disableWhitening(); }); }
+    { Bench b; measure("optimizeSensitivity", [&]{ b.radio->optimizeSensitivity(); }); }
+    { Bench b; measure("setMaxPktSize", [&]{ b.radio->setMaxPktSize(20); }); }
+    { Bench b; measure("wor", [&]{ b.radio->wor(1000); }); }
+    { Bench b; b.radio->wor(1000); measure("wor2rx", [&]{ b.radio->wor2rx(); }); }
+    { Bench b; measure("setPowerDownState", [&]{ b.radio->setPowerDownState(); }); }
+}
+
+int main() {
+    static const uint32_t clocks[] = {500000, 1000000, 2000000, 4000000};
+    printf("spi_hz,method,cs,bytes,snops,bus_us,total_us\n");
+    for (size_t i = 0; i < sizeof(clocks) / sizeof(clocks[0]); i++) {
+        spiHz = clocks[i];
+        runAll();
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+Many nodes report to a gateway at the same moment ("on the hour"), on the CC1101 model.
+Every node has one 20 byte packet to send, all of them call beginSend() at the same time and
+the program polls them round robin, as if every node had its own MCU. The gateway receives
+with the GDO0 interrupt.
+policy=retry : on CC1101_SEND_CCA_FAIL the node calls beginSend() again immediately, the
+busy loop found in many sketches.
+policy=csma : enableCsma(), the library waits a random backoff after a busy CCA.
+Both give up 2 seconds after the start. Licenced under MIT licence
+
+One CSV line per policy and number of nodes :
+policy,nodes,rate_bps,on_air,delivered,cca_fails,backoffs,seconds,goodput_bps
+on_air : frames the nodes sent, the ones not delivered collided
+delivered : packets received by the gateway with correct CRC
+seconds : until the last node finished, goodput_bps = delivered payload bits / seconds
+*/
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <CC1101_RF.h>
+#include "CC1101Sim.h"
+
+static const int MAX_NODES = 32;
+static const byte SIZE = 20;
+static const byte GATEWAY = 1;
+static const uint32_t DEADLINE_MS = 2000;
+
+// Returns the packets received by the gateway
+static int run(bool csma, int nodes, uint32_t bps) {
+    SimHost& host = SimHost::get();
+    host.reset();
+    host.logging = false;
+    // The nodes see a new transmitter after ~10 bits. A node that checks the channel
+    // in this time transmits too, the usual collision of CSMA.
+    host.rssiDelayNs = 10 * 1000000000ull / bps;
+    host.addChip(10, MISO, 2);
+    CC1101 gateway(10);
+    gateway.begin(433.2e6);
+    gateway.setDataRate(bps);
+    gateway.enableAddressCheck(GATEWAY);
+    static CC1101RxQueue<MAX_NODES + 1> queue;
+    gateway.enableRxInterrupt(2, queue);
+
+    static CC1101Sim* chip[MAX_NODES];
+    static CC1101* node[MAX_NODES];
+    static byte packet[MAX_NODES][SIZE];
+    CC1101Stats stats;
+    stats.reset();
+    for (int i = 0; i < nodes; i++) {
+        chip[i] = &host.addChip(20 + i, MISO);
+        node[i] = new CC1101(20 + i);
+        node[i]->begin(433.2e6);
+        node[i]->setDataRate(bps);
+        node[i]->enableAddressCheck(GATEWAY + 1 + i);
+        node[i]->enableStats(stats);
+        if (csma) node[i]->enableCsma(8, DEADLINE_MS);
+        node[i]->setRXstate();
+        packet[i][0] = GATEWAY;
+        packet[i][1] = i;
+        for (byte j = 2; j < SIZE; j++) packet[i][j] = j;
+    }
+    randomSeed(nodes);
+
+    uint32_t t0 = millis();
+    uint64_t ns0 = host.now();
+    for (int i = 0; i < nodes; i++) node[i]->beginSend(packet[i], SIZE);
+    int pending = nodes;
+    while (pending) {
+        pending = 0;
+        for (int i = 0; i < nodes; i++) {
+            byte result = node[i]->poll();
+            if (result == CC1101_SEND_CCA_FAIL && !csma && millis() - t0 < DEADLINE_MS) {
+                node[i]->beginSend(packet[i], SIZE);
+                result = CC1101_SEND_PENDING;
+            }
+            if (result == CC1101_SEND_PENDING) pending++;
+        }
+    }
+    double seconds = (host.now() - ns0) / 1e9;
+    // the last packet is still arriving
+    delay(10 + 1000 * 40 * 8 / bps);
+    int delivered = 0;
+    bool seen[MAX_NODES] = {false};
+    byte rx[64];
+    while (gateway.available()) {
+        if (gateway.read(rx) == SIZE && gateway.crcok() && rx[1] < nodes && !seen[rx[1]]) {
+            seen[rx[1]] = true;
+            delivered++;
+        }
+    }
+    gateway.disableRxInterrupt();
+    int onAir = 0;
+    for (int i = 0; i < nodes; i++) onAir += chip[i]->framesSent;
+    printf("%s,%d,%lu,%d,%d,%u,%u,%.3f,%.0f\n", csma ? "csma" : "retry", nodes, (unsigned long)bps,
+        onAir, delivered, stats.ccaFails, stats.backoffs, seconds, delivered * SIZE * 8 / seconds);
+    for (int i = 0; i < nodes; i++) delete node[i];
+    return delivered;
+}
+
+int main() {
+    static const int counts[] = {4, 12, 24};
+    printf("policy,nodes,rate_bps,on_air,delivered,cca_fails,backoffs,seconds,goodput_bps\n");
+    int failures = 0;
+    for (size_t n = 0; n < sizeof(counts) / sizeof(counts[0]); n++) {
+        run(false, counts[n], 38400);
+        if (run(true, counts[n], 38400) != counts[n]) failures++;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+/*
+CC1101Energy (enableEnergy()) on the CC1101 model. A sensor node sends a 20 byte reading
+every 10 seconds and listens for a reply of the gateway, which never comes, then sleeps.
+The firmware variants differ in the RX window, the power and the sleep (setPowerDownState()
+or wor()). The library counts the time in each state from what it sees; the model knows the
+real state of the chip. Both are converted to a charge with the same currents (the WOR time
+of the model as in wor.cpp). The program fails if they differ more than 5%.
+Licenced under MIT licence
+
+One CSV line per variant :
+variant,cycles,seconds,tx_ms,model_tx_ms,rx_ms,model_rx_ms,uah,model_uah,average_ua,cr2032_days
+uah : the charge the library reports, average_ua : the average current since reset()
+cr2032_days : the battery life with 220mAh, from the average current
+*/
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <CC1101_RF.h>
+#include "CC1101Sim.h"
+
+static const int CYCLES = 30;
+static const uint32_t PERIOD_MS = 10000;
+
+// nA*ns, the time of the model in each state. WOR : the SLEEP time is WOR sleep, plus the
+// crystal start up of the wake ups and the calibration of every 4th (MCSM0 FS_AUTOCAL=3),
+// which take no time in the model.
+static double modelCharge(CC1101Sim& chip, uint64_t now, bool wor, uint32_t txNa) {
+    double q = chip.stateNs(CC1101Sim::T_SLEEP, now) * (double)(wor ? CC1101_SLEEP_WOR_NA : CC1101_SLEEP_NA) +
+        chip.stateNs(CC1101Sim::T_IDLE, now) * (CC1101_IDLE_UA * 1000.0) +
+        chip.stateNs(CC1101Sim::T_OTHER, now) * (CC1101_FS_UA * 1000.0) +
+        chip.stateNs(CC1101Sim::T_RX, now) * (CC1101_RX_UA * 1000.0) +
+        chip.stateNs(CC1101Sim::T_TX, now) * (double)txNa;
+    if (wor) {
+        q += chip.wakeups * 750e9 / CC1101_CRYSTAL_FREQUENCY * 48 * (CC1101_IDLE_UA * 1000.0 - CC1101_SLEEP_WOR_NA);
+        q += chip.wakeups / 4 * 18739e9 / CC1101_CRYSTAL_FREQUENCY * (CC1101_FS_UA * 1000.0 - CC1101_SLEEP_WOR_NA);
+    }
+    return q;
+}
+
+static bool run(const char* variant, uint32_t rxWindowMs, int8_t dbm, bool wor) {
+    SimHost& host = SimHost::get();
+    host.reset();
+    host.logging = false;
+    CC1101Sim& chip = host.addChip(10, MISO, 2);
+    CC1101 radio(10);
+    radio.begin(433.2e6);
+    if (dbm == 0) radio.setPower0dbm();
+    CC1101WorConfig cfg = radio.worConfig(1000);
+    CC1101Energy energy;
+    energy.reset();
+    uint64_t t0 = host.now();
+    double q0 = modelCharge(chip, t0, wor, 0);
+    uint64_t tx0 = chip.stateNs(CC1101Sim::T_TX, t0), rx0 = chip.stateNs(CC1101Sim::T_RX, t0);
+    radio.enableEnergy(energy);
+
+    byte reading[20] = {0};
+    byte packet[64];
+    for (int c = 0; c < CYCLES; c++) {
+        uint32_t start = millis();
+        reading[0] = c;
+        radio.sendPacket(reading, sizeof(reading));
+        uint32_t sent = millis();
+        while (millis() - sent < rxWindowMs) {
+            if (radio.getPacket(packet)) break;
+            delay(1);
+        }
+        if (wor) radio.wor(cfg);
+        else radio.setPowerDownState();
+        delay(PERIOD_MS - (millis() - start));
+    }
+    radio.updateEnergy();
+    uint64_t t1 = host.now();
+    uint32_t txNa = energy.currentNa[dbm == 0 ? CC1101Energy::TX_0DBM : CC1101Energy::TX_10DBM];
+    double modelUah = (modelCharge(chip, t1, wor, txNa) - q0) / 3.6e15;
+    uint32_t txMs = energy.ms[CC1101Energy::TX_10DBM] + energy.ms[CC1101Energy::TX_5DBM] + energy.ms[CC1101Energy::TX_0DBM];
+    double modelTxMs = (chip.stateNs(CC1101Sim::T_TX, t1) - tx0) / 1e6;
+    double modelRxMs = (chip.stateNs(CC1101Sim::T_RX, t1) - rx0) / 1e6;
+    float uah = energy.uAh();
+    double averageUa = energy.averageNa() / 1000.0;
+    printf("%s,%d,%.0f,%lu,%.0f,%lu,%.0f,%.3f,%.3f,%.2f,%.0f\n", variant, CYCLES, (t1 - t0) / 1e9,
+        (unsigned long)txMs, modelTxMs, (unsigned long)energy.ms[CC1101Energy::RX], modelRxMs, uah, modelUah,
+        averageUa, 220000.0 / averageUa / 24);
+    return fabs(uah - modelUah) <= 0.05 * modelUah && fabs(txMs - modelTxMs) <= 0.05 * modelTxMs;
+}
+
+int main() {
+    printf("variant,cycles,seconds,tx_ms,model_tx_ms,rx_ms,model_rx_ms,uah,model_uah,average_ua,cr2032_days\n");
+    int failures = 0;
+    if (!run("rx50ms", 50, 10, false)) failures++;
+    if (!run("rx200ms", 200, 10, false)) failures++;
+    if (!run("rx50ms_0dbm", 50, 0, false)) failures++;
+    if (!run("rx50ms_wor1s", 50, 10, true)) failures++;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,91 @@
+/*
+Messages of 100 to 912 bytes with CC1101Frag on the CC1101 model. Module A sends 50
+messages to module B, which receives the fragments with the GDO0 interrupt and checks
+every completed message byte by byte. With loss>0 the model loses a part of the fragments,
+the incomplete messages must be discarded after the reassembly timeout and the slots reused.
+The program fails if a message is corrupted, or if a message is lost without loss.
+Licenced under MIT licence
+
+One CSV line per data rate, size and loss :
+rate_bps,size,loss,messages,delivered,timeouts,ms_per_message,payload_bps,efficiency
+ms_per_message : from send() until the message is complete at B
+*/
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <CC1101_RF.h>
+#include <CC1101_Frag.h>
+#include "CC1101Sim.h"
+
+static const int MESSAGES = 50;
+
+static bool run(uint32_t rate, uint16_t size, double loss) {
+    SimHost& host = SimHost::get();
+    host.reset();
+    host.logging = false;
+    host.addChip(10, MISO, 2);
+    host.addChip(9, MISO, 3);
+    CC1101 radioA(10);
+    CC1101 radioB(9);
+    radioA.begin(433.2e6);
+    radioB.begin(433.2e6);
+    uint32_t actual = radioA.setDataRate(rate);
+    radioB.setDataRate(rate);
+    static CC1101RxQueue<CC1101_FRAG_MAX_FRAGMENTS + 1> queue;
+    radioB.enableRxInterrupt(3, queue);
+    static CC1101Frag<CC1101_FRAG_MAX_MESSAGE, 1> a(radioA, 0x10);
+    static CC1101Frag<2 * CC1101_FRAG_MAX_MESSAGE, 2> b(radioB, 0x20);
+    a.begin();
+    b.begin();
+    b.timeouts = 0;
+    host.lossRate = loss;
+
+    static byte blob[CC1101_FRAG_MAX_MESSAGE];
+    int delivered = 0;
+    bool corrupted = false;
+    uint64_t busyNs = 0;
+    for (int m = 0; m < MESSAGES; m++) {
+        for (uint16_t i = 0; i < size; i++) blob[i] = m * 31 + i;
+        uint64_t t0 = host.now();
+        a.send(0x20, blob, size);
+        // B polls until the message is complete or discarded
+        uint16_t rxSize = 0;
+        byte src;
+        const byte *msg = NULL;
+        while (msg == NULL && host.now() - t0 < (b.getTimeout() + 50) * 1000000ull) {
+            b.update();
+            msg = b.message(rxSize, src);
+            if (msg == NULL) delayMicroseconds(200);
+        }
+        if (msg) {
+            busyNs += host.now() - t0;
+            if (rxSize != size || src != 0x10 || memcmp(msg, blob, size) != 0) corrupted = true;
+            else delivered++;
+            b.release();
+        }
+    }
+    // the last incomplete message
+    delay(b.getTimeout() + 10);
+    b.update();
+    double msPerMessage = delivered ? busyNs / 1e6 / delivered : 0;
+    double bps = delivered ? delivered * size * 8 / (busyNs / 1e9) : 0;
+    printf("%lu,%u,%.2f,%d,%d,%u,%.1f,%.0f,%.2f\n", (unsigned long)rate, size, loss, MESSAGES, delivered,
+        b.timeouts, msPerMessage, bps, bps / actual);
+    radioB.disableRxInterrupt();
+    if (corrupted || b.dropped) return false;
+    return loss > 0 ? delivered + b.timeouts == MESSAGES : delivered == MESSAGES;
+}
+
+int main() {
+    static const uint32_t rates[] = {38400, 250000};
+    static const uint16_t sizes[] = {100, 200, 400, CC1101_FRAG_MAX_MESSAGE};
+    printf("rate_bps,size,loss,messages,delivered,timeouts,ms_per_message,payload_bps,efficiency\n");
+    int failures = 0;
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            if (!run(rates[r], sizes[s], 0)) failures++;
+        }
+        if (!run(rates[r], 400, 0.05)) failures++;
+    }
+    return failures ? 1 : 0;
+}
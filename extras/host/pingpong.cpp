@@ -0,0 +1,326 @@
+/*
+Two CC1101 modules on the same SPI bus exchange packets, the same way
+two "ping" sketches would do over the air. The program exits with an error
+if a packet is lost, so it can be used as a quick check of the host build.
+Licenced under MIT licence
+*/
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <CC1101_RF.h>
+#include "CC1101Sim.h"
+
+static int failures;
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// TEST2 TEST1 TEST0 of the library below 100kbps. The chip resets them in SLEEP.
+static bool testRegs(const CC1101Sim& chip) {
+    return chip.reg(CC1101_TEST2) == 0x81 && chip.reg(CC1101_TEST1) == 0x35 && chip.reg(CC1101_TEST0) == 0x09;
+}
+
+// A request/reply exchange, both sides poll getPacket() every 50us.
+// Returns the average cycle in us, 0 if a packet is lost. minTurn : the fastest reply of b
+static uint32_t requestReply(CC1101& a, CC1101& b, int rounds, uint32_t* minTurn = NULL) {
+    byte packet[64];
+    if (minTurn) *minTurn = 0xFFFFFFFF;
+    uint64_t t0 = SimHost::get().now();
+    for (int i = 0; i < rounds; i++) {
+        if (!a.sendPacket("request")) return 0;
+        uint32_t t = millis();
+        while (b.getPacket(packet) == 0) {
+            if (millis() - t > 100) return 0;
+            delayMicroseconds(50);
+        }
+        if (!b.sendPacket("reply")) return 0;
+        if (minTurn && b.getTurnaroundUs() < *minTurn) *minTurn = b.getTurnaroundUs();
+        t = millis();
+        while (a.getPacket(packet) == 0) {
+            if (millis() - t > 100) return 0;
+            delayMicroseconds(50);
+        }
+        if (memcmp(packet, "reply", 5) != 0) return 0;
+    }
+    return (SimHost::get().now() - t0) / 1000 / rounds;
+}
+
+int main() {
+    SimHost& host = SimHost::get();
+    // Two modules, CSN on pin 10 and 9, GDO0 on pins 2 and 3
+    CC1101Sim& chipA = host.addChip(10, MISO, 2);
+    CC1101Sim& chipB = host.addChip(9, MISO, 3);
+    CC1101 radioA(10);
+    CC1101 radioB(9);
+    CC1101Stats statsA, statsB;
+    statsA.reset();
+    statsB.reset();
+    radioA.enableStats(statsA);
+    radioB.enableStats(statsB);
+
+    SPI.begin();
+    check(radioA.begin(433.2e6), "radioA.begin()");
+    check(radioB.begin(433.2e6), "radioB.begin()");
+    radioA.setRXstate();
+    radioB.setRXstate();
+    printf("begin+setRXstate: %u transactions, %u bytes, %u SNOPs, %.1f us on the bus\n",
+        host.bus.transactions, host.bus.bytes, host.bus.snops, host.bus.busNs / 1000.0);
+
+    byte packet[64];
+    for (int i = 0; i < 10; i++) {
+        char msg[32];
+        snprintf(msg, sizeof(msg), "ping %d", i);
+        check(radioA.sendPacket(msg), "sendPacket()");
+        delay(5);
+        byte size = radioB.getPacket(packet);
+        check(size == strlen(msg) && memcmp(packet, msg, size) == 0, "packet content");
+        check(radioB.crcok(), "crcok()");
+        check(radioB.getRSSIdbm() == chipA.txRssiDbm, "getRSSIdbm()");
+    }
+
+    // SLEEP loses FSTEST-TEST0, the library writes them again when the chip wakes up
+    radioA.setPowerDownState();
+    check(!testRegs(chipA), "SLEEP resets TEST2-TEST0");
+    radioA.setDataRate(4800); // the same TEST2 TEST1
+    radioA.setRXstate();
+    check(testRegs(chipA), "TEST registers after setPowerDownState()");
+
+    // a sleeping module is woken up by a packet with a long preamble
+    radioB.wor(1000);
+    delay(100);
+    check(radioA.sendPacket((const byte*)"wake", 4, 1200), "sendPacket() with preamble");
+    delay(5);
+    check(digitalRead(3) == LOW, "GDO0 after the packet");
+    byte size = radioB.getPacket(packet);
+    check(size == 4 && radioB.crcok(), "WOR packet");
+    check(testRegs(chipB), "TEST registers after WOR");
+    // wor2rx() writes the WOR registers and leaves the deferred changes for apply()
+    radioB.wor(1000);
+    radioB.deferWrites(true);
+    byte pktlen = chipB.reg(CC1101_PKTLEN);
+    radioB.setMaxPktSize(20);
+    radioB.wor2rx();
+    check(chipB.reg(CC1101_PKTLEN) == pktlen && chipB.reg(CC1101_WORCTRL) == 0xFB, "wor2rx() with deferWrites()");
+    radioB.apply();
+    check(chipB.reg(CC1101_PKTLEN) == 20, "apply() after wor2rx()");
+    radioB.setMaxPktSize(pktlen);
+    radioB.apply();
+    radioB.deferWrites(false);
+    radioB.setRXstate();
+
+    // a packet injected directly to the air
+    host.injectPacket(chipB, (const byte*)"hello", 5, -80);
+    delay(50);
+    size = radioB.getPacket(packet);
+    check(size == 5 && radioB.getRSSIdbm() == -80, "injected packet");
+
+    // the FIFO keeps packets sent back to back (3ms gaps)
+    radioB.enableMultiPacketRx();
+    radioB.setRXstate();
+    for (byte i = 0; i < 3; i++) {
+        byte payload[5] = {'m', 'u', 'l', 't', (byte)('0' + i)};
+        host.injectPacket(chipB, payload, 5, -70, true, i * 30000000ull);
+    }
+    delay(100);
+    for (byte i = 0; i < 3; i++) {
+        size = radioB.getPacket(packet);
+        check(size == 5 && packet[4] == '0' + i && radioB.crcok(), "getPacket() multi packet");
+    }
+    check(radioB.getPacket(packet) == 0, "getPacket() multi packet, empty FIFO");
+    radioB.disableMultiPacketRx();
+
+    // interrupt reception, 3 packets with 2ms gaps (a packet is 23ms at 4800bps),
+    // while the application is busy
+    static CC1101RxQueue<5> rxQueue;
+    radioB.enableRxInterrupt(3, rxQueue);
+    check(SPI.interruptUsers() == 1, "enableRxInterrupt() SPI.usingInterrupt()");
+    for (byte i = 0; i < 3; i++) {
+        byte payload[3] = {'i', 'r', (byte)('0' + i)};
+        host.injectPacket(chipB, payload, 3, -70 - i, true, i * 25000000ull);
+    }
+    delay(100); // the application is busy
+    check(radioA.sendPacket("from A"), "sendPacket() with interrupt RX");
+    delay(100);
+    check(radioB.available() == 4, "available()");
+    for (byte i = 0; i < 3; i++) {
+        size = radioB.read(packet);
+        check(size == 3 && packet[2] == '0' + i && radioB.crcok() && radioB.getRSSIdbm() == -70 - i, "read()");
+    }
+    size = radioB.read(packet);
+    check(size == 6 && memcmp(packet, "from A", 6) == 0, "read() packet of A");
+    check(radioB.read(packet) == 0 && radioB.available() == 0, "empty queue");
+    radioB.disableRxInterrupt();
+    check(SPI.interruptUsers() == 0, "disableRxInterrupt() SPI.notUsingInterrupt()");
+
+    // long packets, the FIFO is drained/refilled while the packet is on the air
+    static byte longTx[600], longRx[600];
+    for (int i = 0; i < 600; i++) longTx[i] = i * 7;
+    radioA.enableLongPackets();
+    radioB.enableLongPackets();
+    radioA.setRXstate();
+    radioB.setRXstate();
+    host.injectPacket(chipB, longTx, 200, -70);
+    delay(30); // the first bytes are in the FIFO
+    uint16_t longSize = radioB.getLongPacket(longRx, sizeof(longRx));
+    check(longSize == 200 && memcmp(longRx, longTx, 200) == 0 && radioB.crcok(), "getLongPacket() 200 bytes");
+    // nobody reads the FIFO of B, it would overflow
+    radioB.setIDLEstate();
+    check(radioA.sendLongPacket(longTx, 255), "sendLongPacket() 255 bytes");
+    {
+        const SimFrame& f = *host.lastFrame;
+        check(f.src == 0 && !f.aborted && f.dataDone && f.data.size() == 256 && f.data[0] == 255 &&
+            memcmp(&f.data[1], longTx, 255) == 0 && chipA.txUnderflows == 0, "long packet on the air");
+    }
+    // infinite length mode, 2 byte length header
+    radioA.enableLongPackets(true);
+    radioB.enableLongPackets(true);
+    radioA.setRXstate();
+    radioB.setRXstate();
+    static byte stream[602];
+    stream[0] = 600 >> 8;
+    stream[1] = 600 & 0xFF;
+    memcpy(stream + 2, longTx, 600);
+    host.injectPacket(chipB, stream, 602, -70);
+    delay(30);
+    longSize = radioB.getLongPacket(longRx, sizeof(longRx));
+    check(longSize == 600 && memcmp(longRx, longTx, 600) == 0 && radioB.crcok(), "getLongPacket() infinite mode");
+    radioB.setIDLEstate();
+    check(radioA.sendLongPacket(longTx, 600), "sendLongPacket() infinite mode");
+    {
+        const SimFrame& f = *host.lastFrame;
+        check(f.src == 0 && !f.aborted && f.dataDone && f.data.size() == 602 &&
+            memcmp(&f.data[0], stream, 602) == 0 && chipA.txUnderflows == 0, "infinite packet on the air");
+    }
+    radioA.disableLongPackets();
+    radioB.disableLongPackets();
+    radioA.setRXstate();
+    radioB.setRXstate();
+    check(radioA.sendPacket("short") && (delay(5), radioB.getPacket(packet) == 5), "normal packets after disableLongPackets()");
+
+    // request/reply at 250kbps, where the calibrations cost more than the packets
+    radioA.setDataRate(250000);
+    radioB.setDataRate(250000);
+    radioA.setRXstate();
+    radioB.setRXstate();
+    uint32_t normalTurn, fastTurn;
+    uint32_t normalCycle = requestReply(radioA, radioB, 20, &normalTurn);
+    radioA.enableFastTurnaround();
+    radioB.enableFastTurnaround();
+    radioA.setRXstate();
+    radioB.setRXstate();
+    unsigned cal0 = chipA.calibrations + chipB.calibrations;
+    uint32_t fastCycle = requestReply(radioA, radioB, 20, &fastTurn);
+    unsigned fastCals = chipA.calibrations + chipB.calibrations - cal0;
+    printf("request/reply 250kbps: cycle %lu us, fastest reply %lu us. Fast turnaround: cycle %lu us, "
+        "fastest reply %lu us, %u calibrations in 80 packets\n", (unsigned long)normalCycle,
+        (unsigned long)normalTurn, (unsigned long)fastCycle, (unsigned long)fastTurn, fastCals);
+    check(normalCycle && fastCycle && fastCycle < normalCycle && fastTurn < normalTurn, "enableFastTurnaround()");
+    check(fastCals >= 16 && fastCals <= 24, "enableFastTurnaround() calibrations");
+    // the reply of the peer arrives before the next poll(), the chip waits in FSTXON
+    check(radioA.beginSend((const byte*)"ping", 4) && radioA.poll() == CC1101_SEND_PENDING, "beginSend() fast turnaround");
+    delay(2);
+    host.injectPacket(chipA, (const byte*)"pong", 4, -60);
+    delay(3);
+    check(chipA.statusState() == 3 && radioA.poll() == CC1101_SEND_OK, "poll() with a reply in FSTXON");
+    check(radioA.getPacket(packet) == 4 && memcmp(packet, "pong", 4) == 0, "poll() reply");
+    check(radioB.getPacket(packet) == 4 && memcmp(packet, "ping", 4) == 0, "beginSend() fast turnaround packet");
+    radioA.disableFastTurnaround();
+    radioB.disableFastTurnaround();
+    radioA.setRXstate();
+    radioB.setRXstate();
+    check(requestReply(radioA, radioB, 2) != 0, "disableFastTurnaround()");
+
+    // a busy channel : sendPacket() fails, with enableCsma() it waits for the channel
+    host.addInterferer(433.2e6, 100000, -60, host.now(), host.now() + 30000000ull);
+    check(!radioA.sendPacket("busy"), "sendPacket() busy channel");
+    radioA.enableCsma();
+    check(radioA.sendPacket("csma") && radioA.getSendAttempts() > 1 && statsA.backoffs > 1, "enableCsma()");
+    delay(2);
+    check(radioB.getPacket(packet) == 4 && memcmp(packet, "csma", 4) == 0, "enableCsma() packet");
+    // the blocking senders back off the same way
+    host.addInterferer(433.2e6, 100000, -60, host.now(), host.now() + 30000000ull);
+    check(radioA.sendLongPacket((const byte*)"long", 4) && radioA.getSendAttempts() > 1, "enableCsma() sendLongPacket()");
+    delay(2);
+    check(radioB.getPacket(packet) == 4 && memcmp(packet, "long", 4) == 0, "enableCsma() sendLongPacket() packet");
+    host.addInterferer(433.2e6, 100000, -60, host.now(), host.now() + 30000000ull);
+    const byte* csmaBatch[] = {(const byte*)"batch"};
+    byte csmaBatchSize[] = {5};
+    check(radioA.sendBatch(csmaBatch, csmaBatchSize, 1) == 1 && radioA.getSendAttempts() > 1, "enableCsma() sendBatch()");
+    delay(2);
+    check(radioB.getPacket(packet) == 5 && memcmp(packet, "batch", 5) == 0, "enableCsma() sendBatch() packet");
+    radioA.enableCsma(5, 20);
+    host.addInterferer(433.2e6, 100000, -60, host.now(), host.now() + 100000000ull);
+    uint32_t t = millis();
+    check(!radioA.sendPacket("late") && millis() - t < 20, "enableCsma() deadline");
+    radioA.disableCsma();
+    host.clearInterferers();
+    radioA.setRXstate();
+    printf("CSMA: %u backoffs, %lu us\n", statsA.backoffs, (unsigned long)statsA.backoffUs);
+
+    // frequency hopping around a narrowband interferer on channel 0, with cached calibrations
+    radioA.setDataRate(38400);
+    radioB.setDataRate(38400);
+    uint32_t spacing = radioA.setChannelPlan(433.2e6, 200000);
+    radioB.setChannelPlan(433.2e6, 200000);
+    check(spacing > 199000 && spacing < 201000, "setChannelPlan() spacing");
+    host.addInterferer(433.2e6, 50000, -50);
+    static CC1101ChannelCal calA[6], calB[6];
+    radioA.calibrateChannels(calA, 6);
+    radioB.calibrateChannels(calB, 6);
+    unsigned hopCal0 = chipA.calibrations + chipB.calibrations;
+    uint64_t hopNs = 0;
+    int hops = 0;
+    for (byte ch = 1; ch < 8; ch++) { // 6 and 7 are not cached
+        radioA.setChannel(ch);
+        uint64_t t0 = host.now();
+        radioB.setChannel(ch);
+        radioB.setRXstate();
+        if (ch < 6) {
+            hopNs += host.now() - t0;
+            hops++;
+        }
+        bool ok = radioA.sendPacket("hop") && (delay(5), radioB.getPacket(packet) == 3) && radioB.crcok();
+        check(ok && radioB.getChannel() == ch, "setChannel() packet");
+    }
+    unsigned hopCals = chipA.calibrations + chipB.calibrations - hopCal0;
+    printf("hopping: %lu us per hop with cached calibrations, %u calibrations in 14 hops\n",
+        (unsigned long)(hopNs / 1000 / hops), hopCals);
+    check(hopCals == 4, "calibrateChannels() no calibration for the cached channels");
+    // the gateway looks for a quiet channel
+    host.addInterferer(433.4e6, 50000, -80);
+    host.addInterferer(433.6e6, 50000, -70);
+    host.addInterferer(433.8e6, 50000, -90);
+    int16_t levels[6];
+    uint64_t scanT0 = host.now();
+    byte quiet = radioB.scanChannels(0, 6, levels, 1000);
+    printf("scan: %d %d %d %d %d %d dBm, channel %u in %lu us\n", levels[0], levels[1], levels[2], levels[3],
+        levels[4], levels[5], quiet, (unsigned long)((host.now() - scanT0) / 1000));
+    check(quiet == 4 && levels[0] == -50 && levels[1] == -80 && levels[2] == -70 && levels[3] == -90 &&
+        levels[4] == host.noiseFloorDbm && radioB.getChannel() == 7 && radioB.getState() == 1, "scanChannels()");
+    radioA.disableChannelCal();
+    radioB.disableChannelCal();
+    radioA.setFrequency(433.2e6);
+    radioB.setFrequency(433.2e6);
+    host.clearInterferers();
+    radioA.setRXstate();
+    radioB.setRXstate();
+    check(radioA.sendPacket("ch0") && (delay(5), radioB.getPacket(packet) == 3), "disableChannelCal()");
+
+    printf("A: sent=%u calibrations=%u  B: received=%u wakeups=%u\n",
+        chipA.framesSent, chipA.calibrations, chipB.framesReceived, chipB.wakeups);
+    // the counters of the library agree with the model
+    check(statsA.packetsSent == chipA.framesSent && statsB.packetsReceived == chipB.framesReceived &&
+        statsA.crcErrors + statsB.crcErrors == 0 && statsA.ccaFails == 2 && statsB.ccaFails == 0, "CC1101Stats packets");
+    check(statsA.spiTransactions + statsB.spiTransactions == host.bus.transactions &&
+        statsA.spiBytes + statsB.spiBytes == host.bus.bytes, "CC1101Stats SPI traffic");
+    printf("A: spi=%lu bytes=%lu getState=%lu polls=%lu  B: spi=%lu bytes=%lu getState=%lu polls=%lu flushes(rx/tx)=%u/%u\n",
+        (unsigned long)statsA.spiTransactions, (unsigned long)statsA.spiBytes, (unsigned long)statsA.stateReads,
+        (unsigned long)statsA.statePolls, (unsigned long)statsB.spiTransactions, (unsigned long)statsB.spiBytes,
+        (unsigned long)statsB.stateReads, (unsigned long)statsB.statePolls, statsB.rxFlushes, statsB.txFlushes);
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
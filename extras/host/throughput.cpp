@@ -0,0 +1,108 @@
+/*
+Payload throughput of sendPacket()/getPacket() at several data rates, measured on the
+CC1101 model. Module A sends 61 byte packets as fast as the library allows and module B
+reads them. mode=batch sends them with sendBatch() 8 at a time, and B collects them with the
+GDO0 interrupt. The 255 byte packets are sent with sendLongPacket() and counted on the air
+(the receiver cannot run at the same time on a single host thread). At 500 kbps the
+interrupt of an 8MHz AVR cannot empty the RX FIFO between back to back 61 byte packets,
+the batch packets are also counted on the air there. The time includes everything the MCU does : SPI transfers, calibrations,
+TX->RX turnaround, preamble and sync word. 2MHz SPI, ATmega328P @ 8MHz (see SimCosts).
+Licenced under MIT licence
+
+One CSV line per data rate :
+rate_bps,actual_bps,chanbw_khz,mod,size,mode,packets,received,seconds,payload_bps,efficiency
+mode is single (sendPacket), long (sendLongPacket), batch (sendBatch) or batch_fast (sendBatch
+with enableFastTurnaround() on the sender)
+payload_bps is the payload bits received per second, efficiency = payload_bps/actual_bps
+*/
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <CC1101_RF.h>
+#include "CC1101Sim.h"
+
+static const int PACKETS = 100;
+
+int main() {
+    static const uint32_t rates[] = {1200, 2400, 4800, 10000, 38400, 76800, 100000, 150000, 250000, 500000};
+    SimHost& host = SimHost::get();
+    enum { SINGLE, LONG, BATCH, BATCH_FAST };
+    static const char* modes[] = {"single", "long", "batch", "batch_fast"};
+    static const uint16_t sizes[] = {MAX_PACKET_LEN, 255, MAX_PACKET_LEN, MAX_PACKET_LEN};
+    static const int BATCH_SIZE = 8;
+    printf("rate_bps,actual_bps,chanbw_khz,mod,size,mode,packets,received,seconds,payload_bps,efficiency\n");
+    int failures = 0;
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        uint16_t size = sizes[s];
+        host.reset();
+        host.logging = false;
+        CC1101Sim& chipA = host.addChip(10, MISO, 2);
+        CC1101Sim& chipB = host.addChip(9, MISO, 3);
+        CC1101 radioA(10);
+        CC1101 radioB(9);
+        radioA.begin(433.2e6);
+        radioB.begin(433.2e6);
+        uint32_t actual = radioA.setDataRate(rates[r]);
+        radioB.setDataRate(rates[r]);
+        int mode = s;
+        bool isLong = mode == LONG;
+        bool isBatch = mode == BATCH || mode == BATCH_FAST;
+        bool onAir = isLong || (isBatch && rates[r] >= 500000);
+        static CC1101RxQueue<BATCH_SIZE + 1> queue;
+        if (isLong) radioA.enableLongPackets();
+        if (mode == BATCH_FAST) radioA.enableFastTurnaround();
+        radioA.setRXstate();
+        if (isLong) radioB.setIDLEstate();
+        else if (isBatch && !onAir) radioB.enableRxInterrupt(3, queue);
+        else radioB.setRXstate();
+
+        byte packet[255];
+        for (uint16_t i = 0; i < size; i++) packet[i] = i;
+        int received = 0;
+        uint64_t t0 = host.now();
+        const byte* batch[BATCH_SIZE];
+        byte batchSizes[BATCH_SIZE];
+        for (int i = 0; i < BATCH_SIZE; i++) {
+            batch[i] = packet;
+            batchSizes[i] = size;
+        }
+        for (int i = 0; i < PACKETS; i++) {
+            if (isBatch) {
+                int n = PACKETS - i < BATCH_SIZE ? PACKETS - i : BATCH_SIZE;
+                byte sent = radioA.sendBatch(batch, batchSizes, n);
+                i += n - 1;
+                if (onAir) received += sent;
+                byte rx[64];
+                while (radioB.available()) {
+                    if (radioB.read(rx) == size && radioB.crcok()) received++;
+                }
+                continue;
+            }
+            if (isLong) {
+                if (radioA.sendLongPacket(packet, size) && !host.lastFrame->aborted &&
+                    host.lastFrame->data.size() == (size_t)size + 1u) received++;
+                continue;
+            }
+            radioA.sendPacket(packet, size);
+            byte rx[64];
+            if (radioB.getPacket(rx) == size && radioB.crcok()) received++;
+        }
+        if (isBatch && !onAir) {
+            // the last packet is still arriving
+            delay(10 + 1000 * 70 * 8 / actual);
+            byte rx[64];
+            while (radioB.available()) {
+                if (radioB.read(rx) == size && radioB.crcok()) received++;
+            }
+            radioB.disableRxInterrupt();
+        }
+        double seconds = (host.now() - t0) / 1e9;
+        double payloadBps = received * size * 8 / seconds;
+        printf("%lu,%lu,%.0f,%s,%u,%s,%d,%d,%.3f,%.0f,%.2f\n", (unsigned long)rates[r], (unsigned long)actual,
+            chipB.channelBwHz() / 1000, (chipB.reg(CC1101_MDMCFG2) & 0x70) == CC1101_MOD_MSK ? "MSK" : "GFSK",
+            size, modes[mode], PACKETS, received, seconds, payloadBps, payloadBps / actual);
+        if (received != PACKETS || chipA.txUnderflows) failures++;
+    }
+    return failures ? 1 : 0;
+}
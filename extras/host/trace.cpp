@@ -0,0 +1,185 @@
+/*
+Latency histograms from the CC1101_TRACE ring (see CC1101::traceDump()).
+Licenced under MIT licence
+
+./build/cc1101_trace dump.bin
+    reads a dump saved from a node (the bytes traceDump() wrote to Serial)
+./build/cc1101_trace
+    two simulated modules exchange ping/pong packets, the dumps are saved to
+    cc1101_trace.bin and analyzed the same way
+
+The intervals, per module (CSN pin) :
+send->RX       sendPacket()/beginSend() called, until the chip is in RX again
+STX->IDLE      the TX strobe until the end of the transmission (air time)
+SRX->RX        the RX strobe until RX state (calibration)
+GDO0->packet   end of packet interrupt, until the application gets the packet
+*/
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <CC1101_RF.h>
+#include "CC1101Sim.h"
+#include <vector>
+
+struct Entry {
+    uint32_t us;
+    byte csn, event, arg, status;
+};
+
+// Collects the output of traceDump(), as Serial would send it
+struct DumpBuffer : public Print {
+    std::vector<uint8_t> bytes;
+    size_t write(uint8_t b) {
+        bytes.push_back(b);
+        return 1;
+    }
+};
+
+// A file can have many dumps one after the other
+static bool parse(const std::vector<uint8_t>& d, std::vector<Entry>& out) {
+    size_t p = 0;
+    while (p + 6 <= d.size()) {
+        if (d[p] != 'C' || d[p + 1] != 'T' || d[p + 2] != 1 || d[p + 3] != 8) return false;
+        size_t count = d[p + 4] | (d[p + 5] << 8);
+        p += 6;
+        if (p + count * 8 > d.size()) return false;
+        for (size_t i = 0; i < count; i++, p += 8) {
+            Entry e;
+            e.us = d[p] | (d[p + 1] << 8) | (d[p + 2] << 16) | ((uint32_t)d[p + 3] << 24);
+            e.csn = d[p + 4];
+            e.event = d[p + 5];
+            e.arg = d[p + 6];
+            e.status = d[p + 7];
+            out.push_back(e);
+        }
+    }
+    return p == d.size();
+}
+
+// From an entry matching (startEvent, startArg) to the next entry of the same
+// module matching (endEvent, endArg). arg -1 matches any value.
+struct Interval {
+    const char* name;
+    byte startEvent;
+    int startArg;
+    byte endEvent;
+    int endArg;
+};
+
+static const Interval intervals[] = {
+    { "send->RX", CC1101_TRACE_SEND, -1, CC1101_TRACE_STATE, 1 },
+    { "STX->IDLE", CC1101_TRACE_STROBE, CC1101_STX, CC1101_TRACE_STATE, 0 },
+    { "SRX->RX", CC1101_TRACE_STROBE, CC1101_SRX, CC1101_TRACE_STATE, 1 },
+    { "GDO0->packet", CC1101_TRACE_GDO0, -1, CC1101_TRACE_RECEIVED, -1 },
+};
+
+static bool matches(const Entry& e, byte event, int arg) {
+    return e.event == event && (arg < 0 || e.arg == arg);
+}
+
+// power of 2 buckets, 1us to 2^25us
+static void histogram(const Interval& iv, const std::vector<Entry>& entries) {
+    std::vector<uint32_t> values;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (!matches(entries[i], iv.startEvent, iv.startArg)) continue;
+        for (size_t j = i + 1; j < entries.size(); j++) {
+            if (entries[j].csn != entries[i].csn) continue;
+            if (matches(entries[j], iv.startEvent, iv.startArg)) break; // a new start, no end
+            if (matches(entries[j], iv.endEvent, iv.endArg)) {
+                values.push_back(entries[j].us - entries[i].us);
+                break;
+            }
+        }
+    }
+    printf("%s : %zu samples", iv.name, values.size());
+    if (values.empty()) {
+        printf("\n\n");
+        return;
+    }
+    uint32_t buckets[26] = {0};
+    uint32_t lo = values[0], hi = values[0];
+    uint64_t sum = 0;
+    for (size_t i = 0; i < values.size(); i++) {
+        uint32_t v = values[i];
+        byte b = 0;
+        while (b < 25 && (v >> (b + 1)) != 0) b++;
+        buckets[b]++;
+        if (v < lo) lo = v;
+        if (v > hi) hi = v;
+        sum += v;
+    }
+    printf(", min %u us, avg %.1f us, max %u us\n", (unsigned)lo, (double)sum / values.size(), (unsigned)hi);
+    uint32_t top = 0;
+    for (int b = 0; b < 26; b++) if (buckets[b] > top) top = buckets[b];
+    for (int b = 0; b < 26; b++) {
+        if (!buckets[b]) continue;
+        char bar[41];
+        int n = (int)(buckets[b] * 40 / top);
+        if (n == 0) n = 1;
+        memset(bar, '#', n);
+        bar[n] = 0;
+        printf("  %8lu-%-8lu us %6u %s\n", 1ul << b, (2ul << b) - 1, (unsigned)buckets[b], bar);
+    }
+    printf("\n");
+}
+
+// ping/pong with 2 simulated modules. B receives with the GDO0 interrupt
+static std::vector<uint8_t> simulate() {
+    SimHost& host = SimHost::get();
+    host.addChip(10, MISO, 2);
+    host.addChip(9, MISO, 3);
+    CC1101 radioA(10);
+    CC1101 radioB(9);
+    static CC1101RxQueue<3> queue;
+    DumpBuffer dump;
+    SPI.begin();
+    if (!radioA.begin(433.2e6) || !radioB.begin(433.2e6)) {
+        fprintf(stderr, "begin() failed\n");
+        exit(1);
+    }
+    radioA.setRXstate();
+    radioB.enableRxInterrupt(3, queue);
+    CC1101::traceClear();
+    byte packet[64];
+    for (int i = 0; i < 50; i++) {
+        radioA.sendPacket("ping");
+        uint32_t t = millis();
+        while (radioB.available() == 0 && millis() - t < 100) delay(1);
+        radioB.read(packet);
+        radioB.sendPacket("pong");
+        t = millis();
+        while (radioA.getPacket(packet) == 0 && millis() - t < 100) delay(1);
+        // the node sends the ring to the PC, before it overflows
+        CC1101::traceDump(dump);
+    }
+    return dump.bytes;
+}
+
+int main(int argc, char** argv) {
+    std::vector<uint8_t> data;
+    if (argc > 1) {
+        FILE* f = fopen(argv[1], "rb");
+        if (!f) {
+            perror(argv[1]);
+            return 1;
+        }
+        int c;
+        while ((c = fgetc(f)) != EOF) data.push_back((uint8_t)c);
+        fclose(f);
+    } else {
+        data = simulate();
+        FILE* f = fopen("cc1101_trace.bin", "wb");
+        if (f) {
+            fwrite(data.data(), 1, data.size(), f);
+            fclose(f);
+        }
+    }
+    std::vector<Entry> entries;
+    if (!parse(data, entries)) {
+        fprintf(stderr, "not a CC1101 trace dump\n");
+        return 1;
+    }
+    printf("%zu entries, %zu bytes\n\n", entries.size(), data.size());
+    for (size_t i = 0; i < sizeof(intervals) / sizeof(intervals[0]); i++) histogram(intervals[i], entries);
+    return 0;
+}
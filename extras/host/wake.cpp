@@ -0,0 +1,153 @@
+/*
+Wake trains (sendWakeTrain() getWakePacket()) and long preambles (sendPacket() with duration)
+on the CC1101 model. Module B sleeps with wor(worConfig(period, wakeFrameUs())) and is woken
+4 times, at different moments of the cycle. With the preamble B listens from the wake up until
+the sync word of the payload. With the train it reads one wake frame, sleeps, and listens again
+one frame before the payload. The wakes are injected to the air with the timing of the sender.
+Then module A sends a train to B in RX, to check the frames and that they are back to back.
+The program fails if B misses a payload, if the train does not save RX time, or if the train
+of A is wrong.
+Licenced under MIT licence
+
+One CSV line per data rate, period and mode :
+rate_bps,period_ms,mode,wakes,received,frames,rx_ms,latency_ms
+frames : the wake frames of a wake up
+rx_ms : the time B is in RX (settling and calibrations included) per wake up
+latency_ms : from the start of the preamble or train until B has the payload
+*/
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <CC1101_RF.h>
+#include "CC1101Sim.h"
+
+static const int WAKES = 4;
+static const byte payload[] = "actuator 7 on";
+
+// The receiver. Returns the RX time per wake up, -1 if a payload is missed
+static double receive(uint32_t rate, uint32_t periodMs, bool train) {
+    SimHost& host = SimHost::get();
+    host.reset();
+    host.logging = false;
+    CC1101Sim& chipB = host.addChip(9, MISO, 3);
+    CC1101 radioB(9);
+    radioB.begin(433.2e6);
+    radioB.setDataRate(rate);
+    radioB.setRXstate(); // calibrates
+    byte test[3] = {chipB.reg(CC1101_TEST2), chipB.reg(CC1101_TEST1), chipB.reg(CC1101_TEST0)};
+    CC1101WorConfig cfg = radioB.worConfig(periodMs, radioB.wakeFrameUs());
+    uint64_t bt = chipB.byteNs();
+    uint64_t frameNs = bt * (chipB.preambleBytes() + chipB.syncBytes() + 1 + CC1101_WAKE_SIZE + 2);
+    // as sendWakeTrain() calculates it
+    uint32_t frames = ((uint64_t)cfg.preambleMs * 1000 + radioB.wakeFrameUs() - 1) / radioB.wakeFrameUs() + 1;
+
+    radioB.wor(cfg);
+    delay(cfg.periodMs);
+    int received = 0;
+    uint64_t rxNs = 0, latencyNs = 0;
+    byte packet[64];
+    for (int i = 0; i < WAKES; i++) {
+        delay(cfg.periodMs * (2 * i + 1) / (2 * WAKES) + 1);
+        uint64_t t0 = host.now();
+        uint64_t rx0 = chipB.stateNs(CC1101Sim::T_RX, t0) + chipB.stateNs(CC1101Sim::T_OTHER, t0);
+        uint64_t endNs;
+        if (train) {
+            for (uint32_t f = 0; f < frames; f++) {
+                uint16_t left = frames - 1 - f;
+                byte w[CC1101_WAKE_SIZE] = {CC1101_WAKE_ID, (byte)(left & 0xFF), (byte)(left >> 8)};
+                host.injectPacket(chipB, w, sizeof(w), -60, true, f * frameNs);
+            }
+            host.injectPacket(chipB, payload, sizeof(payload), -60, true, frames * frameNs);
+            endNs = frames * frameNs;
+        } else {
+            uint64_t extraNs = (uint64_t)cfg.preambleMs * 1000000 - chipB.preambleBytes() * bt;
+            host.injectPacket(chipB, payload, sizeof(payload), -60, true, 0, extraNs);
+            endNs = extraNs;
+        }
+        endNs += (chipB.preambleBytes() + chipB.syncBytes() + 1 + sizeof(payload) + 2) * bt;
+        // the MCU sleeps until GDO0 (the sync word)
+        while (digitalRead(3) == LOW && host.now() - t0 < endNs) delayMicroseconds(100);
+        byte size = radioB.getWakePacket(packet);
+        // the TEST registers, lost in SLEEP, are written again
+        bool testOk = chipB.reg(CC1101_TEST2) == test[0] && chipB.reg(CC1101_TEST1) == test[1] &&
+            chipB.reg(CC1101_TEST0) == test[2];
+        if (size == sizeof(payload) && radioB.crcok() && memcmp(packet, payload, size) == 0 && testOk) received++;
+        uint64_t t1 = host.now();
+        rxNs += chipB.stateNs(CC1101Sim::T_RX, t1) + chipB.stateNs(CC1101Sim::T_OTHER, t1) - rx0;
+        latencyNs += t1 - t0;
+        // the rest of the train
+        if (t1 - t0 < endNs) delay((endNs - (t1 - t0)) / 1000000 + 1);
+        radioB.wor(cfg);
+    }
+    printf("%lu,%lu,%s,%d,%d,%lu,%.1f,%.0f\n", (unsigned long)rate, (unsigned long)cfg.periodMs,
+        train ? "train" : "preamble", WAKES, received, train ? (unsigned long)frames : 0ul,
+        rxNs / 1e6 / WAKES, latencyNs / 1e6 / WAKES);
+    return received == WAKES ? rxNs / 1e6 / WAKES : -1;
+}
+
+// A sends a train to B in RX. Checks the countdown of every frame and the time on the air.
+static bool send(uint32_t rate, uint32_t periodMs) {
+    SimHost& host = SimHost::get();
+    host.reset();
+    host.logging = false;
+    CC1101Sim& chipA = host.addChip(10, MISO, 2);
+    host.addChip(9, MISO, 3);
+    CC1101 radioA(10);
+    CC1101 radioB(9);
+    radioA.begin(433.2e6);
+    radioB.begin(433.2e6);
+    radioA.setDataRate(rate);
+    radioB.setDataRate(rate);
+    static CC1101RxQueue<255> queue;
+    radioB.enableRxInterrupt(3, queue);
+    radioB.setRXstate();
+    CC1101WorConfig cfg = radioB.worConfig(periodMs, radioB.wakeFrameUs());
+    uint64_t t0 = host.now();
+    uint64_t tx0 = chipA.stateNs(CC1101Sim::T_TX, t0);
+    bool ok = radioA.sendWakeTrain(payload, sizeof(payload), cfg.preambleMs);
+    delay(5);
+    uint64_t txNs = chipA.stateNs(CC1101Sim::T_TX, host.now()) - tx0;
+
+    byte packet[64];
+    byte size;
+    long expect = -1; // the countdown of the next frame, -1 before the first one
+    long frames = 0;
+    bool gotPayload = false;
+    while ((size = radioB.read(packet))) {
+        if (!radioB.crcok() || gotPayload) ok = false;
+        else if (size == CC1101_WAKE_SIZE && packet[0] == CC1101_WAKE_ID) {
+            long left = packet[1] | packet[2] << 8;
+            if (expect >= 0 && left != expect) ok = false;
+            expect = left - 1;
+            frames++;
+        } else {
+            gotPayload = size == sizeof(payload) && memcmp(packet, payload, size) == 0 && expect == -1;
+            if (!gotPayload) ok = false;
+        }
+    }
+    radioB.disableRxInterrupt();
+    uint64_t bt = chipA.byteNs();
+    uint64_t expectNs = frames * bt * (chipA.preambleBytes() + chipA.syncBytes() + 1 + CC1101_WAKE_SIZE + 2) +
+        bt * (chipA.preambleBytes() + chipA.syncBytes() + 1 + sizeof(payload) + 2);
+    // the frames are back to back, a gap is preamble
+    bool backToBack = txNs >= expectNs && txNs - expectNs < bt * 4;
+    printf("# sender %lu bps %lu ms : %ld wake frames, tx %.1f ms, expected %.1f ms\n", (unsigned long)rate,
+        (unsigned long)cfg.periodMs, frames, txNs / 1e6, expectNs / 1e6);
+    return ok && gotPayload && backToBack;
+}
+
+int main() {
+    static const uint32_t rates[] = {4800, 38400};
+    static const uint32_t periods[] = {250, 1000};
+    printf("rate_bps,period_ms,mode,wakes,received,frames,rx_ms,latency_ms\n");
+    int failures = 0;
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        for (size_t p = 0; p < sizeof(periods) / sizeof(periods[0]); p++) {
+            double preamble = receive(rates[r], periods[p], false);
+            double train = receive(rates[r], periods[p], true);
+            if (preamble < 0 || train < 0 || train >= preamble) failures++;
+        }
+        if (!send(rates[r], 250)) failures++;
+    }
+    return failures ? 1 : 0;
+}
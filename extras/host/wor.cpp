@@ -0,0 +1,95 @@
+/*
+WakeOnRadio settings of CC1101::worConfig() on the CC1101 model. For every setting module B
+sleeps with wor(config) on a quiet channel for 20 periods, and the time in each chip state is
+converted to an average current with the same currents the library uses (CC1101_SLEEP_WOR_NA
+etc). The model calibrates without spending time, the program adds the calibrations, and
+counts the crystal start up (EVENT1) of every wake up as IDLE current. Then module A wakes B
+5 times (once for periods over 2s, the simulated preamble is slow), at different moments
+of the cycle, with the wake preamble worConfig() calculated.
+The program fails if B misses a packet, or if the prediction is more than 10% off.
+Licenced under MIT licence
+
+One CSV line per setting :
+period_ms,event1,wor_res,rx_timeout_us,preamble_ms,predicted_ua,busy_ua,measured_ua,woken
+busy_ua : predicted, every wake up uses the whole RX window (noise, traffic of other nodes)
+woken : packets received by B, of 5 (1)
+*/
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <CC1101_RF.h>
+#include "CC1101Sim.h"
+
+static const int PERIODS = 20;
+static const int WAKES = 5;
+
+// the chip current in nA*ns, from the time in each state
+static double charge(CC1101Sim& chip, uint64_t now) {
+    return chip.stateNs(CC1101Sim::T_SLEEP, now) * (double)CC1101_SLEEP_WOR_NA +
+        chip.stateNs(CC1101Sim::T_IDLE, now) * (CC1101_IDLE_UA * 1000.0) +
+        chip.stateNs(CC1101Sim::T_OTHER, now) * (CC1101_FS_UA * 1000.0) +
+        chip.stateNs(CC1101Sim::T_RX, now) * (CC1101_RX_UA * 1000.0);
+}
+
+static bool run(uint32_t periodMs, byte event1, byte worRes = 0xFF) {
+    SimHost& host = SimHost::get();
+    host.reset();
+    host.logging = false;
+    host.addChip(10, MISO, 2);
+    CC1101Sim& chipB = host.addChip(9, MISO, 3);
+    CC1101 radioA(10);
+    CC1101 radioB(9);
+    radioA.begin(433.2e6);
+    radioB.begin(433.2e6);
+    radioA.setPowerDownState(); // until the wake ups
+    CC1101WorConfig cfg = radioB.worConfig(periodMs, 0, event1, worRes);
+
+    // the current on a quiet channel
+    radioB.wor(cfg);
+    delay(cfg.periodMs);
+    uint64_t t0 = host.now();
+    double q0 = charge(chipB, t0);
+    uint32_t w0 = chipB.wakeups, c0 = chipB.calibrations;
+    delay((uint64_t)PERIODS * cfg.periodMs);
+    uint64_t t1 = host.now();
+    static const byte event1Periods[8] = {4, 6, 8, 12, 16, 24, 32, 48};
+    double e1Ns = 750e9 / CC1101_CRYSTAL_FREQUENCY * event1Periods[event1 & 7];
+    double calNs = 18739e9 / CC1101_CRYSTAL_FREQUENCY;
+    double q = charge(chipB, t1) - q0 +
+        (chipB.wakeups - w0) * e1Ns * (CC1101_IDLE_UA * 1000.0 - CC1101_SLEEP_WOR_NA) +
+        (chipB.calibrations - c0) * calNs * (CC1101_FS_UA * 1000.0 - CC1101_SLEEP_WOR_NA);
+    double measuredUa = q / (t1 - t0) / 1000;
+
+    // wake ups at different moments of the cycle
+    int woken = 0;
+    int wakes = cfg.periodMs > 2000 ? 1 : WAKES;
+    byte packet[64];
+    for (int i = 0; i < wakes; i++) {
+        delay(cfg.periodMs * (2 * i + 1) / (2 * wakes) + 1);
+        radioA.sendPacket((const byte*)"wake", 4, cfg.preambleMs);
+        radioA.setPowerDownState();
+        // the packet has ended. The MCU reads it at the GDO0 interrupt, before the next
+        // EVENT0 starts RX again, with some periods less than 20ms after the packet
+        delay(2);
+        if (digitalRead(3) == LOW && radioB.getPacket(packet) == 4 && radioB.crcok()) woken++;
+        radioB.wor(cfg);
+    }
+    double predictedUa = cfg.averageNa / 1000.0;
+    printf("%lu,%u,%u,%lu,%lu,%.2f,%.1f,%.2f,%d\n", (unsigned long)cfg.periodMs, event1, cfg.worctrl & 3,
+        (unsigned long)cfg.rxTimeoutUs, (unsigned long)cfg.preambleMs, predictedUa, cfg.busyNa / 1000.0,
+        measuredUa, woken);
+    return woken == wakes && fabs(predictedUa - measuredUa) <= 0.1 * measuredUa;
+}
+
+int main() {
+    static const uint32_t periods[] = {100, 500, 1000, 2000, 10000, 30000};
+    printf("period_ms,event1,wor_res,rx_timeout_us,preamble_ms,predicted_ua,busy_ua,measured_ua,woken\n");
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(periods) / sizeof(periods[0]); i++) {
+        if (!run(periods[i], 7)) failures++;
+    }
+    // a faster crystal start up, and the coarser resolution of WOR_RES=1 at 1s
+    if (!run(1000, 3)) failures++;
+    if (!run(1000, 7, 1)) failures++;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,226 @@
+/*
+(c) Panagiotis Karagiannis MIT Licenece
+
+Reliable delivery over CC1101_RF, see CC1101_Arq.h
+*/
+
+#include <CC1101_Arq.h>
+
+// CC1101ArqPeer flags
+#define PEER_TX_SYNC    0x01 // the peer acknowledged our sequence, no RESET needed
+#define PEER_RX_KNOWN   0x02 // rxSeq is valid
+
+CC1101ArqBase::CC1101ArqBase(CC1101& _radio, const byte _address, CC1101ArqFrame *_frames, const byte _window,
+    CC1101ArqPeer *_peers, const byte _peerCount)
+: framesSent(0), retransmissions(0), timeouts(0), failures(0), acksSent(0), duplicates(0), outOfOrder(0),
+  radio(_radio), address(_address), frames(_frames), window(_window), peers(_peers), peerCount(_peerCount),
+  receiver(NULL), head(0), count(0), inFlight(0), retries(0), maxRetries(8), nextVictim(0), sentAt(0),
+  timeoutUs(CC1101_ARQ_PROCESSING_US) {
+}
+
+void CC1101ArqBase::begin(Receiver _receiver) {
+    receiver = _receiver;
+    // the storage is a member of CC1101Arq, not constructed when the base is
+    memset(peers, 0, sizeof(CC1101ArqPeer)*peerCount);
+    // twice the ACK on the air
+    timeoutUs = 2*radio.frameUs(CC1101_ARQ_HEADER) + CC1101_ARQ_PROCESSING_US;
+    if (radio.rxQueue==NULL) radio.enableMultiPacketRx();
+    radio.setRXstate();
+}
+
+bool CC1101ArqBase::send(const byte dst, const byte *data, const byte size) {
+    if (count==window || dst==0 || data==NULL || size==0 || size>CC1101_ARQ_MAX_PAYLOAD) return false;
+    CC1101ArqPeer *p = peer(dst, true);
+    CC1101ArqFrame& f = frames[(head+count)%window];
+    f.size = CC1101_ARQ_HEADER+size;
+    f.sends = 0;
+    f.data[0] = dst;
+    f.data[1] = address;
+    f.data[2] = 0;
+    f.data[3] = p->txSeq++;
+    memcpy(f.data+CC1101_ARQ_HEADER, data, size);
+    count++;
+    return true;
+}
+
+void CC1101ArqBase::update() {
+    byte packet[64];
+    byte size;
+    while ( (size=receive(packet)) ) {
+        if (size<CC1101_ARQ_HEADER || packet[0]!=address || !radio.crcok()) continue;
+        if (packet[2] & CC1101_ARQ_ACK) onAck(packet[1], packet[3], packet[2]);
+        else onData(packet[1], packet[3], packet[2], packet+CC1101_ARQ_HEADER, size-CC1101_ARQ_HEADER);
+    }
+    if (count==0) return;
+    if (inFlight) {
+        if (micros()-sentAt<timeoutUs) return;
+        timeouts++;
+        retry();
+        if (count==0) return;
+    }
+    sendBurst();
+}
+
+byte CC1101ArqBase::pending() {
+    return count;
+}
+
+uint32_t CC1101ArqBase::getTimeout() {
+    return timeoutUs;
+}
+
+void CC1101ArqBase::setTimeout(const uint32_t us) {
+    timeoutUs = us;
+}
+
+void CC1101ArqBase::setMaxRetries(const byte _maxRetries) {
+    maxRetries = _maxRetries;
+}
+
+// With a full table the peers are replaced in turn. The table must have room for
+// all the peers a node talks to, a replaced peer starts a new sequence.
+CC1101ArqPeer *CC1101ArqBase::peer(const byte addr, const bool create) {
+    CC1101ArqPeer *slot = NULL;
+    for (byte i=0; i<peerCount; i++) {
+        if (peers[i].addr==addr) return &peers[i];
+        if (peers[i].addr==0 && slot==NULL) slot = &peers[i];
+    }
+    if (!create) return NULL;
+    if (slot==NULL) {
+        slot = &peers[nextVictim];
+        nextVictim = (nextVictim+1)%peerCount;
+    }
+    slot->addr = addr;
+    // the RESET tells the peer where the sequence starts
+    slot->txSeq = 0;
+    slot->flags = 0;
+    return slot;
+}
+
+// The messages from head to the same peer
+byte CC1101ArqBase::burstSize() {
+    byte dst = frames[head].data[0];
+    byte n = 1;
+    while (n<count && frames[(head+n)%window].data[0]==dst) n++;
+    return n;
+}
+
+// Go-back-N : every burst starts from the oldest message not acknowledged. Until the peer
+// acknowledges the sequence, a RESET starts it at the oldest message.
+void CC1101ArqBase::sendBurst() {
+    const byte *packets[CC1101_ARQ_MAX_WINDOW];
+    byte sizes[CC1101_ARQ_MAX_WINDOW];
+    byte n = burstSize();
+    CC1101ArqPeer *p = peer(frames[head].data[0], true);
+    if ((p->flags & PEER_TX_SYNC)==0) {
+        // No payload, a repeated RESET (the ACK was lost) delivers nothing twice
+        byte reset[CC1101_ARQ_HEADER] = { frames[head].data[0], address,
+            CC1101_ARQ_RESET | CC1101_ARQ_POLL, frames[head].data[3] };
+        radio.sendPacket(reset, CC1101_ARQ_HEADER);
+        inFlight = 1;
+        sentAt = micros();
+        return;
+    }
+    for (byte i=0; i<n; i++) {
+        CC1101ArqFrame& f = frames[(head+i)%window];
+        f.data[2] = 0;
+        if (i==n-1) f.data[2] |= CC1101_ARQ_POLL;
+        if (f.sends) retransmissions++;
+        if (f.sends<255) f.sends++;
+        packets[i] = f.data;
+        sizes[i] = f.size;
+    }
+    // CCA failure : nothing is sent, the timeout retries as for a lost burst
+    framesSent += radio.sendBatch(packets, sizes, n);
+    inFlight = n;
+    sentAt = micros();
+}
+
+void CC1101ArqBase::retry() {
+    inFlight = 0;
+    if (++retries>maxRetries) drop();
+}
+
+// The burst at head is not delivered after maxRetries
+void CC1101ArqBase::drop() {
+    byte n = burstSize();
+    CC1101ArqPeer *p = peer(frames[head].data[0], false);
+    if (p) p->flags &= ~PEER_TX_SYNC;
+    head = (head+n)%window;
+    count -= n;
+    failures += n;
+    retries = 0;
+}
+
+// seq : the next number the peer expects. Acknowledges the messages before it, and the
+// rest of the burst is sent again at once.
+void CC1101ArqBase::onAck(const byte src, const byte seq, const byte flags) {
+    CC1101ArqPeer *p = peer(src, false);
+    if (p==NULL || inFlight==0 || frames[head].data[0]!=src) return;
+    if (flags & CC1101_ARQ_RESET) {
+        p->flags &= ~PEER_TX_SYNC;
+        retry();
+        return;
+    }
+    if ((p->flags & PEER_TX_SYNC)==0) {
+        // the ACK of our RESET, the data follows
+        if (seq!=frames[head].data[3]) {
+            retry();
+            return;
+        }
+        inFlight = 0;
+        p->flags |= PEER_TX_SYNC;
+        retries = 0;
+        return;
+    }
+    byte acked = 0;
+    while (acked<inFlight && (int8_t)(seq-frames[head].data[3])>0) {
+        head = (head+1)%window;
+        count--;
+        acked++;
+    }
+    if (acked==0) {
+        retry();
+        return;
+    }
+    inFlight = 0;
+    p->flags |= PEER_TX_SYNC;
+    retries = 0;
+}
+
+void CC1101ArqBase::onData(const byte src, const byte seq, const byte flags, const byte *data, const byte size) {
+    CC1101ArqPeer *p = peer(src, true);
+    if (flags & CC1101_ARQ_RESET) {
+        // Always a new sequence. The sender may have restarted with the numbers we have seen.
+        p->rxSeq = seq;
+        p->flags |= PEER_RX_KNOWN;
+        if (flags & CC1101_ARQ_POLL) sendAck(src, p->rxSeq, 0);
+        return;
+    }
+    if ( (p->flags & PEER_RX_KNOWN)==0 ) {
+        // we restarted, the sender must start a new sequence
+        if (flags & CC1101_ARQ_POLL) sendAck(src, 0, CC1101_ARQ_RESET);
+        return;
+    }
+    int8_t d = seq-p->rxSeq;
+    if (d==0) {
+        p->rxSeq++;
+        if (receiver) receiver(src, data, size);
+    } else if (d<0) {
+        duplicates++;
+    } else {
+        outOfOrder++;
+    }
+    if (flags & CC1101_ARQ_POLL) sendAck(src, p->rxSeq, 0);
+}
+
+void CC1101ArqBase::sendAck(const byte dst, const byte seq, const byte flags) {
+    byte ack[CC1101_ARQ_HEADER] = { dst, address, (byte)(CC1101_ARQ_ACK | flags), seq };
+    if (radio.sendPacket(ack, CC1101_ARQ_HEADER)) acksSent++;
+}
+
+// With enableRxInterrupt() the packets come from the queue
+byte CC1101ArqBase::receive(byte *packet) {
+    if (radio.rxQueue) return radio.read(packet);
+    return radio.getPacket(packet);
+}
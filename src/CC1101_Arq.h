@@ -0,0 +1,143 @@
+/*
+(c) Panagiotis Karagiannis MIT Licenece
+
+Reliable delivery over CC1101_RF (ARQ). Every message gets a sequence number per peer
+and the receiver acknowledges it. The sender keeps up to WINDOW messages not acknowledged
+and sends them back to back with CC1101::sendBatch(), the last frame asks for the ACK.
+The receiver answers with the next sequence number it expects (cumulative ACK, go-back-N)
+and delivers the messages in order and once. Before the first burst to a peer (and after a
+restart of either node) the sender sends a RESET frame without payload, and the data follows
+its ACK. A RESET always starts a new sequence, so the nodes do not need randomSeed().
+
+#include <CC1101_Arq.h>
+CC1101 radio;
+CC1101Arq<4> link(radio, MY_ADDRESS); // 4 messages in flight, 4 peers
+void received(byte src, const byte *data, byte size) { ... }
+setup() : radio.begin(433.2e6); link.begin(received);
+loop() : link.send(GATEWAY, data, size); link.update();
+
+Frame : dst src flags seq payload (up to 57 bytes)
+*/
+
+#ifndef CC1101_Arq_h
+#define CC1101_Arq_h
+
+#include "CC1101_RF.h"
+
+#define CC1101_ARQ_HEADER       4
+#define CC1101_ARQ_MAX_PAYLOAD  (MAX_PACKET_LEN-CC1101_ARQ_HEADER)
+// sendBatch() takes the burst from the stack
+#define CC1101_ARQ_MAX_WINDOW   16
+
+// The flags byte
+#define CC1101_ARQ_ACK    0x01 // no payload, seq is the next sequence number the receiver expects
+#define CC1101_ARQ_POLL   0x02 // the last data frame of a burst, the receiver sends an ACK
+#define CC1101_ARQ_RESET  0x04 // no payload : the sender starts a new sequence with seq
+                               // ACK : the receiver does not know the sender, start again
+
+#ifndef CC1101_ARQ_PROCESSING_US
+// From the end of the last frame until the ACK is on the air : the loop() of the peer,
+// getPacket(), the 500us before STX and the calibration. Part of the retransmission timeout.
+#define CC1101_ARQ_PROCESSING_US 3000
+#endif
+
+// A message in the send window, the frame as it goes on the air
+struct CC1101ArqFrame {
+	byte size;
+	byte sends;
+	byte data[MAX_PACKET_LEN];
+};
+
+struct CC1101ArqPeer {
+	byte addr;      // 0 : free slot
+	byte txSeq;     // the sequence number of the next message to the peer
+	byte rxSeq;     // the next sequence number expected from the peer
+	byte flags;
+};
+
+// The state and the code. Declare it with the template below.
+class CC1101ArqBase {
+	public:
+		typedef void (*Receiver)(byte src, const byte *data, byte size);
+
+		CC1101ArqBase(CC1101& _radio, const byte _address, CC1101ArqFrame *_frames, const byte _window,
+			CC1101ArqPeer *_peers, const byte _peerCount);
+
+		// After radio.begin() and the radio settings (data rate etc). The received messages
+		// are given to receiver, from update(). The chip stays in RX after a packet
+		// (enableMultiPacketRx()) so the frames of a burst are not lost, or the radio can use
+		// enableRxInterrupt(), call it before begin(). Forgets the peers. Sets the chip to RX state.
+		void begin(Receiver receiver);
+
+		// Copies the message to the window. Returns false if the window is full (update() sends
+		// the window and frees it as the ACKs come), dst is 0, or size is 0 or larger than 57.
+		bool send(const byte dst, const byte *data, const byte size);
+
+		// Receives (data and ACKs), sends ACKs, sends the window and retransmits after the
+		// timeout. Call it from loop() as often as possible, the peer waits for the ACKs.
+		// Blocks only while a burst or an ACK is on the air.
+		void update();
+
+		// Messages in the window, not acknowledged yet
+		byte pending();
+
+		// From the last frame of a burst until the retransmission. begin() calculates it from
+		// the data rate : twice the air time of an ACK + CC1101_ARQ_PROCESSING_US
+		uint32_t getTimeout();
+		void setTimeout(const uint32_t us);
+
+		// A burst is sent up to 1+maxRetries times without progress, then the messages to that
+		// peer are dropped (failures). The default is 8.
+		void setMaxRetries(const byte maxRetries);
+
+		// Counters, the application can read or clear them
+		uint32_t framesSent;      // data frames, the retransmissions included
+		uint32_t retransmissions;
+		uint16_t timeouts;        // no ACK in time
+		uint16_t failures;        // messages dropped after maxRetries
+		uint32_t acksSent;
+		uint16_t duplicates;      // received again, the ACK was lost
+		uint16_t outOfOrder;      // discarded, a previous frame was lost
+
+	private:
+		CC1101& radio;
+		const byte address;
+		CC1101ArqFrame *frames;
+		const byte window;
+		CC1101ArqPeer *peers;
+		const byte peerCount;
+		Receiver receiver;
+		// the ring of messages, head is the oldest
+		byte head;
+		byte count;
+		// frames of the last burst, 0 : not waiting for an ACK
+		byte inFlight;
+		byte retries;
+		byte maxRetries;
+		byte nextVictim;
+		uint32_t sentAt;
+		uint32_t timeoutUs;
+
+		CC1101ArqPeer *peer(const byte addr, const bool create);
+		byte burstSize();
+		void sendBurst();
+		void retry();
+		void drop();
+		void onAck(const byte src, const byte seq, const byte flags);
+		void onData(const byte src, const byte seq, const byte flags, const byte *data, const byte size);
+		void sendAck(const byte dst, const byte seq, const byte flags);
+		byte receive(byte *packet);
+};
+
+// CC1101Arq<4> link(radio, 0x10); // 4 messages of 63 bytes RAM, up to 4 peers
+template <byte WINDOW, byte PEERS=4> class CC1101Arq : public CC1101ArqBase {
+	static_assert(WINDOW>=1 && WINDOW<=CC1101_ARQ_MAX_WINDOW, "CC1101Arq : WINDOW 1-16");
+	static_assert(PEERS>=1, "CC1101Arq : at least 1 peer");
+	public:
+		CC1101Arq(CC1101& radio, const byte address) : CC1101ArqBase(radio, address, frames, WINDOW, peers, PEERS) {}
+	private:
+		CC1101ArqFrame frames[WINDOW];
+		CC1101ArqPeer peers[PEERS];
+};
+
+#endif
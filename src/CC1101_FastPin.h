@@ -0,0 +1,61 @@
+/*
+(c) Panagiotis Karagiannis MIT Licenece
+
+Compile time pins for CC1101T<CSN, MISO>. With the pin number known to the
+compiler, a digitalWrite() (~50 cycles on AVR, the pin->port lookup is done
+at runtime from flash tables) becomes a single sbi/cbi instruction.
+
+ATmega328P/168/88 (Uno Nano ProMini) : direct PORTx/PINx access.
+Teensy and the host build : digitalWriteFast() digitalReadFast().
+Other MCUs : digitalWrite() digitalRead() as the CC1101 class.
+
+Included by CC1101_RF.h
+*/
+
+#ifndef CC1101_FastPin_h
+#define CC1101_FastPin_h
+
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__) || defined(__AVR_ATmega168__) || \
+    defined(__AVR_ATmega168P__) || defined(__AVR_ATmega88__) || defined(__AVR_ATmega88P__)
+
+// Arduino pins 0-7 PORTD, 8-13 PORTB, 14-19 (A0-A5) PORTC
+template <byte PIN> struct CC1101FastPin {
+    static_assert(PIN<20, "CC1101FastPin : pins 0-19 on this MCU");
+    static constexpr byte mask = 1 << (PIN<8 ? PIN : (PIN<14 ? PIN-8 : PIN-14));
+    static void high() {
+        if (PIN<8) PORTD |= mask; else if (PIN<14) PORTB |= mask; else PORTC |= mask;
+    }
+    static void low() {
+        if (PIN<8) PORTD &= ~mask; else if (PIN<14) PORTB &= ~mask; else PORTC &= ~mask;
+    }
+    static bool read() {
+        return (PIN<8 ? PIND : (PIN<14 ? PINB : PINC)) & mask;
+    }
+};
+
+#elif defined(CORE_TEENSY) || defined(CC1101_HOST)
+
+template <byte PIN> struct CC1101FastPin {
+    static void high() { digitalWriteFast(PIN, HIGH); }
+    static void low() { digitalWriteFast(PIN, LOW); }
+    static bool read() { return digitalReadFast(PIN); }
+};
+
+#else
+
+template <byte PIN> struct CC1101FastPin {
+    static void high() { digitalWrite(PIN, HIGH); }
+    static void low() { digitalWrite(PIN, LOW); }
+    static bool read() { return digitalRead(PIN); }
+};
+
+#endif
+
+// The pin access of CC1101T, see CC1101Pins. The pin arguments are the same pins.
+template <byte CSN, byte MISO_PIN> struct CC1101FastPins {
+    static void csnLow(const byte) { CC1101FastPin<CSN>::low(); }
+    static void csnHigh(const byte) { CC1101FastPin<CSN>::high(); }
+    static bool misoHigh(const byte) { return CC1101FastPin<MISO_PIN>::read(); }
+};
+
+#endif
@@ -0,0 +1,170 @@
+/*
+(c) Panagiotis Karagiannis MIT Licenece
+
+Fragmentation and reassembly over CC1101_RF, see CC1101_Frag.h
+*/
+
+#include <CC1101_Frag.h>
+
+// CC1101FragSlot state
+#define SLOT_FREE      0
+#define SLOT_PARTIAL   1
+#define SLOT_COMPLETE  2
+
+CC1101FragBase::CC1101FragBase(CC1101& _radio, const byte _address, byte *_arena, const uint16_t _slotSize,
+    CC1101FragSlot *_slots, const byte _slotCount)
+: messagesSent(0), messagesReceived(0), fragmentsReceived(0), timeouts(0), dropped(0),
+  radio(_radio), address(_address), arena(_arena), slotSize(_slotSize), slots(_slots), slotCount(_slotCount),
+  current(NULL), nextId(0), timeoutMs(1000) {
+}
+
+void CC1101FragBase::begin() {
+    // the storage is a member of CC1101Frag, not constructed when the base is
+    memset(slots, 0, sizeof(CC1101FragSlot)*slotCount);
+    current = NULL;
+    nextId = random(256);
+    // The fragments of the largest message on the air, twice, and 100ms for the loop()
+    // of the receiver
+    uint16_t fragments = (slotSize+CC1101_FRAG_PAYLOAD-1)/CC1101_FRAG_PAYLOAD;
+    timeoutMs = 2ul*fragments*radio.frameUs(MAX_PACKET_LEN)/1000 + 100;
+    if (radio.rxQueue==NULL) radio.enableMultiPacketRx();
+    radio.setRXstate();
+}
+
+// send() -> sendBatch()
+struct FragMessage {
+    byte header[CC1101_FRAG_HEADER];
+    const byte *data;
+    uint16_t size;
+    byte last;
+};
+
+static byte fragment(void *ctx, const byte index, byte *frame) {
+    FragMessage *m = (FragMessage*)ctx;
+    uint16_t offset = index*CC1101_FRAG_PAYLOAD;
+    byte len = m->size-offset>CC1101_FRAG_PAYLOAD ? CC1101_FRAG_PAYLOAD : m->size-offset;
+    if (frame) {
+        memcpy(frame, m->header, CC1101_FRAG_HEADER-1);
+        frame[CC1101_FRAG_HEADER-1] = (index<<4) | m->last;
+        memcpy(frame+CC1101_FRAG_HEADER, m->data+offset, len);
+    }
+    return CC1101_FRAG_HEADER+len;
+}
+
+bool CC1101FragBase::send(const byte dst, const byte *data, const uint16_t size) {
+    if (data==NULL || size==0 || size>CC1101_FRAG_MAX_MESSAGE) return false;
+    FragMessage m;
+    m.header[0] = dst;
+    m.header[1] = address;
+    m.header[2] = nextId++;
+    m.data = data;
+    m.size = size;
+    m.last = (size-1)/CC1101_FRAG_PAYLOAD;
+    if (radio.sendBatch(fragment, &m, m.last+1)!=m.last+1) return false;
+    messagesSent++;
+    return true;
+}
+
+void CC1101FragBase::update() {
+    byte packet[64];
+    byte size;
+    while ( (size=receive(packet)) ) {
+        if (radio.crcok()) handle(packet, size);
+    }
+    for (byte i=0; i<slotCount; i++) {
+        CC1101FragSlot& s = slots[i];
+        if (s.state==SLOT_PARTIAL && millis()-s.started>timeoutMs) {
+            s.state = SLOT_FREE;
+            timeouts++;
+        }
+    }
+}
+
+// Every fragment is copied once, to its final place in the slot
+bool CC1101FragBase::handle(const byte *packet, const byte size) {
+    if (size<=CC1101_FRAG_HEADER || packet[0]!=address) return false;
+    byte index = packet[3]>>4;
+    byte last = packet[3] & 0x0F;
+    byte len = size-CC1101_FRAG_HEADER;
+    if (index>last) return false;
+    fragmentsReceived++;
+    uint16_t offset = index*CC1101_FRAG_PAYLOAD;
+    CC1101FragSlot *s = slotFor(packet[1], packet[2]);
+    if (s==NULL || (index<last && len!=CC1101_FRAG_PAYLOAD) || offset+len>slotSize) {
+        dropped++;
+        return true;
+    }
+    if (s->state==SLOT_COMPLETE) return true; // the message is received already
+    if (s->state==SLOT_FREE) {
+        s->state = SLOT_PARTIAL;
+        s->started = millis();
+        s->received = 0;
+        s->src = packet[1];
+        s->id = packet[2];
+        s->last = last;
+    }
+    memcpy(arena+(s-slots)*slotSize+offset, packet+CC1101_FRAG_HEADER, len);
+    s->received |= 1u<<index;
+    if (index==last) s->size = offset+len;
+    if (s->received==(uint16_t)((2ul<<s->last)-1)) {
+        s->state = SLOT_COMPLETE;
+        messagesReceived++;
+    }
+    return true;
+}
+
+// The slot of the message, or a free one. NULL if all are used
+CC1101FragSlot *CC1101FragBase::slotFor(const byte src, const byte id) {
+    CC1101FragSlot *empty = NULL;
+    for (byte i=0; i<slotCount; i++) {
+        CC1101FragSlot& s = slots[i];
+        if (s.state!=SLOT_FREE && s.src==src && s.id==id) return &s;
+        if (s.state==SLOT_FREE && empty==NULL) empty = &s;
+    }
+    return empty;
+}
+
+// The completed message with the oldest first fragment
+CC1101FragSlot *CC1101FragBase::oldest() {
+    CC1101FragSlot *o = NULL;
+    for (byte i=0; i<slotCount; i++) {
+        CC1101FragSlot& s = slots[i];
+        if (s.state==SLOT_COMPLETE && (o==NULL || (int32_t)(s.started-o->started)<0)) o = &s;
+    }
+    return o;
+}
+
+const byte *CC1101FragBase::message(uint16_t &size, byte &src) {
+    current = oldest();
+    if (current==NULL) return NULL;
+    size = current->size;
+    src = current->src;
+    return arena+(current-slots)*slotSize;
+}
+
+void CC1101FragBase::release() {
+    if (current) current->state = SLOT_FREE;
+    current = NULL;
+}
+
+byte CC1101FragBase::available() {
+    byte n = 0;
+    for (byte i=0; i<slotCount; i++) {
+        if (slots[i].state==SLOT_COMPLETE) n++;
+    }
+    return n;
+}
+
+uint32_t CC1101FragBase::getTimeout() {
+    return timeoutMs;
+}
+
+void CC1101FragBase::setTimeout(const uint32_t ms) {
+    timeoutMs = ms;
+}
+
+// With enableRxInterrupt() the packets come from the queue
+byte CC1101FragBase::receive(byte *packet) {
+    if (radio.rxQueue) return radio.read(packet);
+    return radio.getPacket(packet);
+}
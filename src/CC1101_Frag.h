@@ -0,0 +1,118 @@
+/*
+(c) Panagiotis Karagiannis MIT Licenece
+
+Messages larger than a packet, up to 912 bytes. The message is split in fragments of up to
+57 bytes, sent back to back with CC1101::sendBatch() (one CCA, no calibration between them).
+The receiver copies every fragment to its place in a reassembly slot of a static arena, so
+the completed message is contiguous and is used where it is, without a copy and without malloc.
+A message with a lost fragment is discarded after a timeout. There are no retransmissions,
+the application can repeat the message (or use small messages with CC1101_Arq.h).
+
+#include <CC1101_Frag.h>
+CC1101 radio;
+CC1101Frag<1024, 2> frag(radio, MY_ADDRESS); // 2 messages of up to 512 bytes
+setup() : radio.begin(433.2e6); frag.begin();
+sender : frag.send(GATEWAY, config, sizeof(config));
+receiver, loop() :
+	frag.update();
+	uint16_t size;
+	byte src;
+	const byte *msg = frag.message(size, src);
+	if (msg) { ... frag.release(); }
+
+Fragment : dst src id index<<4|last payload. last is the index of the last fragment.
+*/
+
+#ifndef CC1101_Frag_h
+#define CC1101_Frag_h
+
+#include "CC1101_RF.h"
+
+#define CC1101_FRAG_HEADER        4
+#define CC1101_FRAG_PAYLOAD       (MAX_PACKET_LEN-CC1101_FRAG_HEADER)
+#define CC1101_FRAG_MAX_FRAGMENTS 16
+#define CC1101_FRAG_MAX_MESSAGE   (CC1101_FRAG_MAX_FRAGMENTS*CC1101_FRAG_PAYLOAD)
+
+struct CC1101FragSlot {
+	uint32_t started;   // millis() of the first fragment
+	uint16_t received;  // one bit per fragment
+	uint16_t size;      // known when the last fragment is received
+	byte src;
+	byte id;
+	byte last;
+	byte state;
+};
+
+// The state and the code. Declare it with the template below.
+class CC1101FragBase {
+	public:
+		CC1101FragBase(CC1101& _radio, const byte _address, byte *_arena, const uint16_t _slotSize,
+			CC1101FragSlot *_slots, const byte _slotCount);
+
+		// After radio.begin() and the radio settings (data rate etc). The chip stays in RX after a
+		// packet (enableMultiPacketRx()) so the fragments are not lost, or the radio can use
+		// enableRxInterrupt() (recommended), call it before begin(). The reassembly timeout is
+		// calculated from the data rate. Sets the chip to RX state.
+		void begin();
+
+		// Sends size bytes (up to 912, and the slot size of the receiver) to dst. Returns false
+		// if the arguments are wrong or the channel is busy. Sets the chip to RX state.
+		bool send(const byte dst, const byte *data, const uint16_t size);
+
+		// Receives the fragments and discards the incomplete messages after the timeout.
+		// Call it from loop() as often as possible.
+		void update();
+
+		// For applications that read the packets themselves. Returns false if the packet
+		// is not a fragment for this node.
+		bool handle(const byte *packet, const byte size);
+
+		// The oldest completed message, NULL if there is none. The message stays in the arena
+		// (its slot does not receive) until release() frees it.
+		const byte *message(uint16_t &size, byte &src);
+		void release();
+
+		// Completed messages waiting for message()
+		byte available();
+
+		// ms from the first fragment until an incomplete message is discarded
+		uint32_t getTimeout();
+		void setTimeout(const uint32_t ms);
+
+		// Counters, the application can read or clear them
+		uint16_t messagesSent;
+		uint16_t messagesReceived;
+		uint32_t fragmentsReceived;
+		uint16_t timeouts;  // incomplete messages discarded
+		uint16_t dropped;   // fragments without a free slot, or too large for the slot
+
+	private:
+		CC1101& radio;
+		const byte address;
+		byte *arena;
+		const uint16_t slotSize;
+		CC1101FragSlot *slots;
+		const byte slotCount;
+		// the slot of message(), for release()
+		CC1101FragSlot *current;
+		byte nextId;
+		uint32_t timeoutMs;
+
+		CC1101FragSlot *slotFor(const byte src, const byte id);
+		CC1101FragSlot *oldest();
+		byte receive(byte *packet);
+};
+
+// CC1101Frag<1024, 2> frag(radio, 0x10); // 2 reassembly slots of 512 bytes
+template <uint16_t ARENA, byte SLOTS=2> class CC1101Frag : public CC1101FragBase {
+	static_assert(SLOTS>=1, "CC1101Frag : at least 1 slot");
+	static_assert(ARENA/SLOTS>=CC1101_FRAG_PAYLOAD, "CC1101Frag : the slots are smaller than a fragment");
+	public:
+		CC1101Frag(CC1101& radio, const byte address) : CC1101FragBase(radio, address, arena,
+			ARENA/SLOTS>CC1101_FRAG_MAX_MESSAGE ? CC1101_FRAG_MAX_MESSAGE : ARENA/SLOTS, slots, SLOTS) {}
+	private:
+		byte arena[ARENA];
+		CC1101FragSlot slots[SLOTS];
+};
+
+#endif
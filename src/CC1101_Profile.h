@@ -0,0 +1,191 @@
+/*
+(c) Panagiotis Karagiannis MIT Licenece
+
+Compile time radio profiles. The register values for the frequency, data rate,
+deviation and channel filter are calculated by the compiler and the whole
+register image is stored in flash. begin<Profile>() loads it with one SPI burst,
+without any runtime arithmetic.
+
+typedef CC1101Profile<868300000, 38400, 20630> MyProfile;
+radio.begin<MyProfile>();
+
+The formulas are from the CC1101 manual SWRS061I (section 12, 13, 16, 21).
+Included by CC1101_RF.h
+*/
+
+#ifndef CC1101_Profile_h
+#define CC1101_Profile_h
+
+// constexpr register calculations. They are evaluated by the compiler when
+// the arguments are constants, but can also be used at runtime.
+struct CC1101Calc {
+    // FREQ2:FREQ1:FREQ0 = freq*2^16/fxosc
+    static constexpr uint32_t freqWord(const uint32_t freq) {
+        return ((uint64_t)freq<<16) / CC1101_CRYSTAL_FREQUENCY;
+    }
+
+    // DRATE_E is the largest exponent with 256*2^E*fxosc/2^28 <= rate
+    static constexpr byte drateE0(const uint32_t rate, const byte e=0) {
+        return (e<15 && ((uint64_t)rate<<20) >= ((uint64_t)CC1101_CRYSTAL_FREQUENCY<<(e+1))) ? drateE0(rate, e+1) : e;
+    }
+    // 256+DRATE_M rounded. Can be 512 due to rounding, this is handled by drateE drateM
+    static constexpr uint16_t drateM256(const uint32_t rate, const byte e) {
+        return (((uint64_t)rate<<(28-e)) + CC1101_CRYSTAL_FREQUENCY/2) / CC1101_CRYSTAL_FREQUENCY;
+    }
+    static constexpr byte drateE(const uint32_t rate) {
+        return drateM256(rate, drateE0(rate)) >= 512 ? drateE0(rate)+1 : drateE0(rate);
+    }
+    static constexpr byte drateM(const uint32_t rate) {
+        return drateM256(rate, drateE0(rate)) >= 512 ? 0 : drateM256(rate, drateE0(rate)) - 256;
+    }
+    // the rate the chip actually uses
+    static constexpr uint32_t dataRate(const byte e, const byte m) {
+        return ((uint64_t)(256+m)*CC1101_CRYSTAL_FREQUENCY<<e) >> 28;
+    }
+
+    // deviation = fxosc/2^17*(8+M)*2^E E=0..7 M=0..7
+    static constexpr byte deviationE0(const uint32_t dev, const byte e=0) {
+        return (e<7 && ((uint64_t)dev<<17) >= ((uint64_t)CC1101_CRYSTAL_FREQUENCY<<(e+4))) ? deviationE0(dev, e+1) : e;
+    }
+    static constexpr byte deviationM8(const uint32_t dev, const byte e) {
+        return (((uint64_t)dev<<(17-e)) + CC1101_CRYSTAL_FREQUENCY/2) / CC1101_CRYSTAL_FREQUENCY;
+    }
+    static constexpr byte deviatn(const uint32_t dev) {
+        return deviationM8(dev, deviationE0(dev)) >= 16 ?
+            ((deviationE0(dev)+1)<<4) :
+            (deviationE0(dev)<<4) | (deviationM8(dev, deviationE0(dev)) - 8);
+    }
+
+    // channel filter bandwidth = fxosc/(8*(4+M)*2^E) E=0..3 M=0..3
+    // i=0..15 is the bandwidth order, 0 is the narrowest (58kHz with 26Mhz crystal)
+    static constexpr uint32_t chanBw(const byte i) {
+        return CC1101_CRYSTAL_FREQUENCY / (8ul*(4+3-(i&3))<<(3-(i>>2)));
+    }
+    // the narrowest filter which is at least bw
+    static constexpr byte chanBwIndex(const uint32_t bw, const byte i=0) {
+        return (i<15 && chanBw(i)<bw) ? chanBwIndex(bw, i+1) : i;
+    }
+    // CHANBW_E:CHANBW_M, the high nibble of MDMCFG4
+    static constexpr byte chanBwBits(const uint32_t bw) {
+        return (byte)(((3-(chanBwIndex(bw)>>2))<<2) | (3-(chanBwIndex(bw)&3)));
+    }
+
+    // channel spacing = fxosc/2^18*(256+M)*2^E E=0..3 M=0..255 (25-405KHz with 26Mhz crystal)
+    static constexpr byte chanSpcE0(const uint32_t spacing, const byte e=0) {
+        return (e<3 && ((uint64_t)spacing<<10) >= ((uint64_t)CC1101_CRYSTAL_FREQUENCY<<(e+1))) ? chanSpcE0(spacing, e+1) : e;
+    }
+    static constexpr uint16_t chanSpcM256(const uint32_t spacing, const byte e) {
+        return (((uint64_t)spacing<<(18-e)) + CC1101_CRYSTAL_FREQUENCY/2) / CC1101_CRYSTAL_FREQUENCY;
+    }
+    // CHANSPC_E, the low bits of MDMCFG1
+    static constexpr byte chanSpcE(const uint32_t spacing) {
+        return (chanSpcM256(spacing, chanSpcE0(spacing)) >= 512 && chanSpcE0(spacing)<3) ? chanSpcE0(spacing)+1 : chanSpcE0(spacing);
+    }
+    // CHANSPC_M, MDMCFG0
+    static constexpr byte chanSpcM(const uint32_t spacing) {
+        return chanSpcM256(spacing, chanSpcE0(spacing)) >= 512 ?
+            (chanSpcE0(spacing)<3 ? 0 : 255) : chanSpcM256(spacing, chanSpcE0(spacing)) - 256;
+    }
+    // the spacing the chip actually uses
+    static constexpr uint32_t chanSpacing(const byte e, const byte m) {
+        return ((uint64_t)(256+m)*CC1101_CRYSTAL_FREQUENCY<<e) >> 18;
+    }
+
+    // the PATABLE values the library uses
+    static constexpr byte paTable(const int8_t dbm) {
+        return dbm==10 ? 0xC5 : (dbm==5 ? 0x86 : 0x50);
+    }
+};
+
+// Freq      carrier frequency in Hz.
+// DataRate  in bps (baud) 600-500000.
+// Deviation FSK frequency deviation in Hz. The default is the one of the 4800bps preset.
+// ChanBW    the receiver filter is the narrowest one with at least this bandwidth.
+// PowerDbm  10 5 or 0 as setPower10dbm() setPower5dbm() setPower0dbm()
+//
+// The other registers have the values used by begin(freq).
+template <uint32_t Freq, uint32_t DataRate=4800, uint32_t Deviation=25390,
+          uint32_t ChanBW=101562, int8_t PowerDbm=10>
+struct CC1101Profile {
+    static_assert( (Freq>=300000000ul && Freq<=348000000ul) ||
+                   (Freq>=387000000ul && Freq<=464000000ul) ||
+                   (Freq>=779000000ul && Freq<=928000000ul), "CC1101Profile : Freq out of the CC1101 bands");
+    static_assert(DataRate>=600 && DataRate<=500000, "CC1101Profile : DataRate 600-500000 bps");
+    static_assert(Deviation>=1600 && Deviation<=380000, "CC1101Profile : Deviation 1.6-380kHz");
+    static_assert(ChanBW<=CC1101Calc::chanBw(15), "CC1101Profile : ChanBW is too wide");
+    static_assert(PowerDbm==10 || PowerDbm==5 || PowerDbm==0, "CC1101Profile : PowerDbm 10 5 or 0");
+
+    static constexpr byte FREQ2 = (CC1101Calc::freqWord(Freq)>>16) & 0xFF;
+    static constexpr byte FREQ1 = (CC1101Calc::freqWord(Freq)>>8) & 0xFF;
+    static constexpr byte FREQ0 = CC1101Calc::freqWord(Freq) & 0xFF;
+    static constexpr byte MDMCFG4 = (CC1101Calc::chanBwBits(ChanBW)<<4) | CC1101Calc::drateE(DataRate);
+    static constexpr byte MDMCFG3 = CC1101Calc::drateM(DataRate);
+    static constexpr byte DEVIATN = CC1101Calc::deviatn(Deviation);
+    static constexpr byte PATABLE = CC1101Calc::paTable(PowerDbm);
+
+    // registers 0x00-0x2E in flash
+    static const byte registers[CC1101_CONFIG_SIZE];
+};
+
+// Most values are from RF studio.
+// The setters (setBaudrate38000bps() enableAddressCheck() etc) change them later.
+template <uint32_t Freq, uint32_t DataRate, uint32_t Deviation, uint32_t ChanBW, int8_t PowerDbm>
+const byte CC1101Profile<Freq, DataRate, Deviation, ChanBW, PowerDbm>::registers[CC1101_CONFIG_SIZE] PROGMEM = {
+    0x29, // IOCFG2   CHIP_RDYn (the default)
+    0x2E, // IOCFG1   High impedance (the default)
+    0x06, // IOCFG0   Asserts when SyncWord is sent/received. 0x01 was used by openelec and panstamp lib
+    0x4F, // FIFOTHR  The "F" 0b1111 ensures that GDO0 asserts only if a full packet is received
+    0xD3, // SYNC1
+    0x91, // SYNC0
+    // max pkt size = 61. Dealing with larger packets is hard
+    // and given the higher possibility of crc errors
+    // probably not worth the effort. Generally the packets should be as
+    // short as possible
+    MAX_PACKET_LEN, // PKTLEN 0x3D
+    CC1101_PKTCTRL1_DEFAULT_VAL, // PKTCTRL1 PQT, two status bytes appended, no address check
+    0x45, // PKTCTRL0 WHITE_DATA=1 PKT_FORMAT=0(normal) CRC_EN=1 LENGTH_CONFIG=1(var len)
+    0x00, // ADDR
+    0x00, // CHANNR
+    0x06, // FSCTRL1  optimizeSensitivity()
+    0x00, // FSCTRL0
+    FREQ2,
+    FREQ1,
+    FREQ0,
+    MDMCFG4,
+    MDMCFG3,
+    0x17, // MDMCFG2  0b0-001-0-111 OptSensit-GFSK-MANCHESTER_OFF-32bitSyncWord+CarrSense
+    0x22, // MDMCFG1
+    0xF8, // MDMCFG0
+    DEVIATN,
+    0x07, // MCSM2
+    0x30, // MCSM1    CCA enabled TX->IDLE RX->IDLE
+    0x18, // MCSM0    calibration IDLE->RX/TX
+    0x16, // FOCCFG
+    0x6C, // BSCFG
+    0x43, // AGCCTRL2
+    0x40, // AGCCTRL1
+    0x91, // AGCCTRL0
+    0x87, // WOREVT1
+    0x6B, // WOREVT0
+    0xFB, // WORCTRL
+    0x56, // FREND1
+    0x10, // FREND0
+    0xE9, // FSCAL3
+    0x2A, // FSCAL2
+    0x00, // FSCAL1
+    0x1F, // FSCAL0
+    0x41, // RCCTRL1
+    0x00, // RCCTRL0
+    0x59, // FSTEST
+    0x7F, // PTEST
+    0x3F, // AGCTEST
+    0x81, // TEST2
+    0x35, // TEST1
+    0x09, // TEST0
+};
+
+// The two baudrate presets of the library
+typedef CC1101Profile<433000000ul, 4800, 25390> CC1101Preset4800;
+typedef CC1101Profile<433000000ul, 38400, 20630> CC1101Preset38000;
+
+#endif
@@ -128,11 +128,29 @@ On Oct 22, 2016 10:07 PM, "Simon Monk" <srmonk@gmail.com> wrote:
 #define CC1101_TXBYTES      0x3A
 #define CC1101_RXBYTES      0x3B
 
+// Not a possible status byte in practice (CHIP_RDYn=1 and TXFIFO_UNDERFLOW), see getState()
+#define CC1101_STATUS_UNKNOWN 0xFF
+
+// The configuration registers 0x00-0x2E
+#define CC1101_CONFIG_SIZE  0x2F
+
 //CC1101 PATABLE,TXFIFO,RXFIFO
 #define CC1101_PATABLE      0x3E
 #define CC1101_TXFIFO       0x3F
 #define CC1101_RXFIFO       0x3F
 
+// MDMCFG2 MOD_FORMAT
+#define CC1101_MOD_2FSK     0x00
+#define CC1101_MOD_GFSK     0x10
+#define CC1101_MOD_MSK      0x70
+
+// sendStatus() poll()
+#define CC1101_SEND_NONE     0 // no beginSend() yet
+#define CC1101_SEND_PENDING  1 // the packet is not sent yet, call poll()
+#define CC1101_SEND_OK       2 // the packet is sent, the chip is in RX
+#define CC1101_SEND_CCA_FAIL 3 // other devices are talking, the packet is not sent
+#define CC1101_SEND_ERROR    4 // beginSend() called with wrong arguments
+
 // The library enforces this maximum packet size
 // The internal CC1101 buffer is 64bytes but 3 bytes can be used for LQI RSSI an address check
 #define MAX_PACKET_LEN 61
@@ -141,18 +159,241 @@ On Oct 22, 2016 10:07 PM, "Simon Monk" <srmonk@gmail.com> wrote:
 #define  CC1101_CRYSTAL_FREQUENCY 26000000ul
 #endif
 
+#ifndef CC1101_SPI_CLOCK
+// The default SPI clock. The CC1101 accepts up to 6.5MHz when the bytes of a burst
+// are sent without gaps (buffer transfers), 9MHz for single register access and 10MHz
+// only with 100ns gaps between the bytes.
+#define CC1101_SPI_CLOCK 4000000ul
+#endif
+
 #ifndef CC1101_PKTSTATUS_PQT
 // 0 (no preamble detection) - 7 max 4*PQT preamble detection
 #define CC1101_PKTSTATUS_PQT 4
 #endif
+// enableCsma() : the backoff before the first CCA is 0 to 2^CC1101_CSMA_MIN_BE slots,
+// BE grows by one after every busy CCA, up to CC1101_CSMA_MAX_BE
+#ifndef CC1101_CSMA_MIN_BE
+#define CC1101_CSMA_MIN_BE 4
+#endif
+#ifndef CC1101_CSMA_MAX_BE
+#define CC1101_CSMA_MAX_BE 7
+#endif
+
 // TODO explanation
 #define CC1101_PKTCTRL1_DEFAULT_VAL (CC1101_PKTSTATUS_PQT*32+4)
 
+#include "CC1101_Profile.h"
+#include "CC1101_FastPin.h"
+
+// Define CC1101_TRACE as the number of entries (build_flags = -D CC1101_TRACE=64 in
+// platformio.ini) to record the activity of the library in a RAM ring, for latency
+// analysis. Every entry is 8 bytes and costs a micros() call. See CC1101::traceDump()
+#ifdef CC1101_TRACE
+#define CC1101_TRACE_STROBE   1 // a command strobe (not SNOP). arg=strobe, status=the reply
+#define CC1101_TRACE_STATE    2 // getState() returns a new state. arg=state
+#define CC1101_TRACE_FIFO_WR  3 // arg=bytes written to the TX FIFO
+#define CC1101_TRACE_FIFO_RD  4 // arg=bytes read from the RX FIFO
+#define CC1101_TRACE_GDO0     5 // GDO0 falling edge, enableRxInterrupt()
+#define CC1101_TRACE_SEND     6 // a send function is called. arg=size (255 max)
+#define CC1101_TRACE_RECEIVED 7 // a packet is returned to the application. arg=size (255 max)
+#endif
+
 //************************************* class **************************************************//
 
+// A packet received by the GDO0 interrupt. See CC1101::enableRxInterrupt()
+struct CC1101Packet {
+	byte size;
+	byte data[MAX_PACKET_LEN];
+	byte status[2]; // RSSI, CRC_OK|LQI as appended by the chip
+};
+
+// Ring of received packets. The interrupt writes head and the application (read()) writes
+// tail, so no locking is needed. One slot is always empty, a queue of N slots holds N-1 packets.
+// Declare it with the template below.
+class CC1101RxQueueBase {
+	public:
+		CC1101RxQueueBase(CC1101Packet *_slots, byte _size) : slots(_slots), size(_size), head(0), tail(0), dropped(0) {}
+		CC1101Packet *slots;
+		const byte size;
+		volatile byte head;
+		volatile byte tail;
+		// packets lost because the queue was full
+		volatile uint16_t dropped;
+};
+
+// CC1101RxQueue<5> rxQueue; // 4 packets, 64 bytes RAM per slot
+template <byte N> class CC1101RxQueue : public CC1101RxQueueBase {
+	public:
+		CC1101RxQueue() : CC1101RxQueueBase(buf, N) {}
+	private:
+		CC1101Packet buf[N];
+};
+
+// Counters of a module, see CC1101::enableStats(). The application owns the struct
+// and can read or reset() it at any time. With enableRxInterrupt() the interrupt also
+// updates it, read it with the interrupts disabled if the values must be consistent.
+struct CC1101Stats {
+	uint32_t packetsSent;     // sendPacket() sendPacketSlowMCU() sendLongPacket() sendBatch() poll()
+	uint32_t packetsReceived; // getPacket() getLongPacket() and the interrupt queue, CRC errors included
+	uint32_t crcErrors;       // received packets with CRC_OK=0
+	uint16_t ccaFails;        // packets not sent, the channel was busy
+	uint16_t backoffs;        // random backoffs before a CCA (enableCsma())
+	uint32_t backoffUs;       // the total time of the backoffs
+	uint16_t wrongRxSize;     // length byte 0, larger than 61 (or the buffer), or larger than the FIFO bytes
+	uint16_t fifoLeftovers;   // getPacket() found bytes after the packet ("FIFO STILL HAS BYTES")
+	uint16_t rxOverflows;     // RXFIFO_OVERFLOW
+	uint16_t rxFlushes;       // SFRX strobes, getPacket() flushes after every packet
+	uint16_t txFlushes;       // SFTX strobes, the send functions flush after every packet
+	uint32_t spiTransactions;
+	uint32_t spiBytes;        // the header bytes included
+	uint32_t stateReads;      // getState() calls
+	uint32_t statePolls;      // SNOPs sent by getState(), 1 byte transactions
+	void reset() { memset(this, 0, sizeof(*this)); }
+};
+
+// Typical currents at 433MHz 3V (SWRS061I tables 4 and 6) for the energy estimates.
+// Other bands and modules can define them before #include <CC1101_RF.h>
+#ifndef CC1101_SLEEP_WOR_NA
+#define CC1101_SLEEP_WOR_NA 500   // SLEEP with the RC oscillator running (WOR), nA
+#endif
+#ifndef CC1101_IDLE_UA
+#define CC1101_IDLE_UA      1700  // IDLE, and the crystal start up (EVENT1)
+#endif
+#ifndef CC1101_FS_UA
+#define CC1101_FS_UA        8400  // calibration, synthesizer settling, FSTXON
+#endif
+#ifndef CC1101_RX_UA
+#define CC1101_RX_UA        15700
+#endif
+#ifndef CC1101_SLEEP_NA
+#define CC1101_SLEEP_NA     200   // SLEEP, setPowerDownState(), nA
+#endif
+// TX with the PATABLE values of setPower10dbm() setPower5dbm() setPower0dbm()
+#ifndef CC1101_TX_10DBM_UA
+#define CC1101_TX_10DBM_UA  29200
+#endif
+#ifndef CC1101_TX_5DBM_UA
+#define CC1101_TX_5DBM_UA   19400
+#endif
+#ifndef CC1101_TX_0DBM_UA
+#define CC1101_TX_0DBM_UA   16000
+#endif
+
+// wor(config), calculated by CC1101::worConfig()
+struct CC1101WorConfig {
+	byte worctrl;          // EVENT1 RC_CAL WOR_RES
+	byte mcsm2;            // RX_TIME_RSSI RX_TIME_QUAL RX_TIME
+	uint16_t event0;       // WOREVT1:WOREVT0
+	uint32_t periodMs;     // the EVENT0 period the chip uses
+	uint32_t rxTimeoutUs;  // the RX window, when there is a carrier
+	uint32_t preambleMs;   // the shortest wake preamble of the sender, sendPacket(data, size, preambleMs)
+	uint32_t averageNa;    // the average current with a quiet channel
+	uint32_t busyNa;       // the average current when every wake up uses the whole RX window (noise)
+};
+
+// CC1101::sendWakeTrain() : a wake frame is CC1101_WAKE_ID and the number of wake frames
+// that follow it (LSB MSB), the payload follows the last one. getWakePacket() takes any 3 byte
+// packet starting with CC1101_WAKE_ID for a wake frame.
+#define CC1101_WAKE_ID      0xFE
+#define CC1101_WAKE_SIZE    3
+
+// The synthesizer calibration of a channel, see CC1101::calibrateChannels()
+struct CC1101ChannelCal {
+	byte fscal[3]; // FSCAL3 FSCAL2 FSCAL1
+};
+
+// Time in each state of a module, and the charge, see CC1101::enableEnergy(). The application
+// owns the struct and can change the currents (nA) after reset(), for another band or module.
+// wor(config) sets currentNa[WOR] to config.averageNa, the last setting is used for all the
+// WOR time.
+struct CC1101Energy {
+	enum { SLEEP, WOR, IDLE, FS, RX, TX_10DBM, TX_5DBM, TX_0DBM, STATES };
+	uint32_t ms[STATES];        // the time in each state
+	uint16_t us[STATES];        // and the us not yet counted in ms
+	uint32_t currentNa[STATES];
+	// Clears the times and loads the default currents (CC1101_RX_UA etc)
+	void reset();
+	// The MCU slept and micros() did not advance (AVR power down), the module was in state
+	void add(const byte state, const uint32_t ms);
+	// The charge since reset(), in uAh. Call CC1101::updateEnergy() first.
+	float uAh();
+	// The average current since reset(), in nA
+	uint32_t averageNa();
+};
+
+// sendBatch() with packets made on the fly
+typedef byte (*CC1101FrameSource)(void *ctx, const byte index, byte *frame);
+
+// The pin access of CC1101, with digitalWrite() digitalRead(). The pins are known at runtime.
+// CC1101T uses CC1101FastPins (CC1101_FastPin.h) instead.
+struct CC1101Pins {
+	static void csnLow(const byte csn) { digitalWrite(csn, LOW); }
+	static void csnHigh(const byte csn) { digitalWrite(csn, HIGH); }
+	static bool misoHigh(const byte miso) { return digitalRead(miso); }
+};
+
+// What all the modules share, whatever their pins. The code is in CC1101_RF.cpp
+class CC1101Common {
+	protected:
+		// Interrupt RX. The GDO0 interrupt does not use the SPI bus if the main program
+		// is in the middle of a transaction (inSpi) with any module. The work is done by
+		// chipDeselect() then, with rxDrain. Only one module can use the interrupt.
+		static volatile bool inSpi;
+		static volatile bool rxPending;
+		static volatile bool rxDraining;
+		static void (*rxDrain)();
+
+		// the frames of sendFrames(), made on the fly
+		typedef byte (*FrameSource)(void *ctx, const uint16_t index, byte *frame);
+		// sendWakeTrain() : the wake frames, then the payload
+		struct WakeTrain {
+			const byte *data;
+			byte size;
+			uint16_t frames;
+		};
+		static byte wakeFrame(void *ctx, const uint16_t index, byte *frame);
+		// sendBatch() with arrays
+		struct BatchArrays {
+			const byte * const *packets;
+			const byte *sizes;
+		};
+		static byte batchArrays(void *ctx, const byte index, byte *frame);
+		// sendBatch() with a CC1101FrameSource, the index of sendFrames() is 16 bits
+		struct BatchSource {
+			CC1101FrameSource source;
+			void *ctx;
+		};
+		static byte batchSource(void *ctx, const uint16_t index, byte *frame);
+
+		// SWRS061I table 31 : the RX timeout in us for EVENT0=1 and a 26MHz crystal, x1000.
+		// [WOR_RES][RX_TIME], in PROGMEM
+		static const uint16_t worRxTimeout[4][7];
+		// us for a number of crystal periods
+		static uint32_t xoscUs(const uint32_t cycles);
+
+#ifdef CC1101_TRACE
+		static void trace(const byte csn, const byte event, const byte arg, const byte status);
+
+	public:
+		// Writes the trace ring, oldest entry first, and empties it. All the modules
+		// share the ring. The format (little endian) :
+		// 'C' 'T' version=1 entry_size=8 count(uint16) and count entries of
+		// micros(uint32) csn_pin event arg status_byte
+		// extras/host/trace.cpp makes latency histograms from it.
+		static void traceDump(Print& out);
+		static void traceClear();
+#endif
+};
+
 // An instance of the CC1101 represents a CC1101 chip
 // we can configure it and send receive packets by calling methods of an instance.
-class CC1101 {
+// Pins is the CSN/MISO access : CC1101 is CC1101Radio<CC1101Pins>, CC1101T has compile
+// time pins. The functions are in CC1101_RFImpl.h
+template <class Pins>
+class CC1101Radio : public CC1101Common {
+	// the ARQ and fragmentation layers read from the interrupt queue when there is one
+	friend class CC1101ArqBase;
+	friend class CC1101FragBase;
 	private:
 		// Some of the functions have different name than the original library
 		// The SPI functions have removed. Now the library uses
@@ -167,9 +408,74 @@ class CC1101 {
 		void readBurstRegister(byte addr, byte *buffer, byte num);
 		byte readStatusRegister(byte addr);
 
-		// Sets the registers used by this library. Called automatically by begin()
-		void setCommonRegisters();
-		
+		// FREQ2 FREQ1 FREQ0 values for a carrier frequency
+		static void frequencyToRegisters(const uint32_t freq, byte *freqRegs);
+
+		// beginSend() poll() state
+		enum { TX_NONE, TX_BACKOFF, TX_WAIT_CCA, TX_PREAMBLE, TX_ON_AIR };
+		byte txStage;
+		byte sendResult;
+		byte txSize;
+		const byte *txData;
+		uint32_t txTimer;
+		uint32_t txDuration;
+		// millis() of the beginSend() call, and the STX strobes (CCAs) of the packet
+		uint32_t txStart;
+		byte txAttempts;
+
+		// enableCsma(), csmaMaxAttempts=0 : one CCA, no backoff
+		byte csmaMaxAttempts;
+		uint16_t csmaDeadlineMs;
+		uint16_t csmaSlotUs;
+		uint32_t txBackoffUs;
+		bool csmaBackoff();
+		bool csmaStx();
+
+		// micros() of the beginSend() call, then the turnaround time
+		uint32_t turnaroundUs;
+
+		// enableFastTurnaround()
+		bool fastTurnaround;
+		byte turnCalEvery;
+		byte turnCount;
+		bool turnaroundCalDue();
+		bool txEnded(const byte state);
+		void setOffModes(const bool stayInRx);
+
+		// used by begin(freq) and begin<Profile>()
+		bool loadImage(const byte *image);
+		void writeImage(const byte pa);
+
+		// RAM copy of the configuration registers 0x00-0x2E, loaded by begin().
+		// The setters compare with it and do not touch the chip if nothing changes.
+		// FSCAL3-FSCAL1 are modified by the chip itself after calibration, and
+		// the copy has the begin() values for them.
+		byte regs[CC1101_CONFIG_SIZE];
+		// one bit per register, set when the copy has a value not yet written to the chip
+		byte dirty[(CC1101_CONFIG_SIZE+7)/8];
+		// PATABLE[0], the only PA entry the library uses
+		byte paTable;
+		bool paDirty;
+		// setters only update regs[] and wait for apply()
+		bool deferred;
+		// FSTEST-TEST0 (0x29-0x2E) are lost in SLEEP (SPWD and WOR) and must be written
+		// again when the chip wakes up, before it leaves IDLE
+		bool sleepLost;
+		void markSleepLost();
+		void restoreSleepLost();
+
+		void setModem(const byte mdmcfg4, const byte mdmcfg3, const byte deviatn, const byte modFormat);
+
+		// changes the RAM copy of a register and marks it dirty
+		void setRegister(byte addr, byte value);
+		void setPaTable(byte value);
+		// writes the dirty registers, if not in deferred mode. Sets the chip to IDLE state
+		// but only if some register is actually changed.
+		void commit();
+		// writes every run of consecutive dirty registers in [first, end) with a single burst
+		void writeDirty(const byte first=0, const byte end=CC1101_CONFIG_SIZE);
+		bool isDirty();
+
 		// Additions to the original Library
 
 		// The SlaveSelect Pin. By default is the SS pin, but but can be any pin.
@@ -183,26 +489,100 @@ class CC1101 {
 		// Usually the default SPI bus of the target architecture. It can be another spi bus
 		// however, or SoftwareSPI.
 		SPIClass& spi;
+
+		// Every access is a SPI transaction, other devices on the bus may use other settings
+		SPISettings spiSettings;
+
+		// SPWD SWOR SXOFF : the chip may sleep, waitMiso() waits for the crystal. 0 : awake
+		byte sleepStrobe;
 		
 		void waitMiso();
+		// Air time of one byte in us (without FEC/Manchester, a lower bound). The chip
+		// state changes at byte boundaries, the wait loops poll once per byte.
+		uint16_t byteTime();
+		// The RSSI register is updated every 8*2^FILTER_LENGTH/(2*BWchannel) (SWRS061I 17.3)
+		uint16_t rssiPeriodUs();
+		static int16_t rssiToDbm(const byte rssi);
 		void chipSelect();
         void chipDeselect();
 
 		// Only for debugging
 		void printRegs();
 
+		// Interrupt RX, the module of enableRxInterrupt() is rxRadio. See CC1101Common
+		CC1101RxQueueBase *rxQueue;
+		byte rxPin;
+		static CC1101Radio *rxRadio;
+		static void rxIsr();
+		static void drainRxRadio();
+		void rxInterrupt();
+		void drainRxFifo();
+
+		// enableMultiPacketRx() getPacket()
+		byte rxSize;
+		byte getPacketMulti(byte *rxBuffer);
+		byte readFifoBytes(const byte addr);
+		void flushRx();
+
+		// sendLongPacket() getLongPacket()
+		void prepareTx();
+		void writeRegisterNow(const byte addr, const byte value);
+		void switchToFixedLength(const uint16_t remaining, bool &fixed);
+
+		// sendBatch() sendWakeTrain(), up to 65535 frames
+		uint16_t sendFrames(FrameSource source, void *ctx, const uint16_t count, bool sent[]);
+		void writeFrame(FrameSource source, void *ctx, const uint16_t index);
+
 		// The 2 bytes appended by the hardware to a received packet.
 		// contains rssi and lqi values of the last getPacket() operation.
 		byte status[2];
 
+		// The status byte of the last SPI access, or CC1101_STATUS_UNKNOWN after a
+		// command strobe (the state is changing)
+		byte chipStatus;
+
+		// calibrateChannels(), NULL if the chip calibrates itself
+		CC1101ChannelCal *channelCal;
+		byte channelCalCount;
+
+		// enableStats(), NULL if the counters are disabled
+		CC1101Stats *stats;
+
+		// enableEnergy(), NULL if the time is not counted
+		CC1101Energy *energy;
+		byte energyState;
+		uint32_t energySince;
+		void countState(const byte state);
+		byte txState();
+		void countRx(const byte lqiCrc);
+
+		// The last CC1101_TRACE_STATE of the module, only used with CC1101_TRACE
+		byte traceState;
+
+		// CSN and MISO access, inlined from Pins
+		void csnLow() { Pins::csnLow(CSNpin); }
+		void csnHigh() { Pins::csnHigh(CSNpin); }
+		bool misoHigh() { return Pins::misoHigh(MISOpin); }
+
 	public:
-		CC1101(const byte _csn=SS,
-		const byte _miso=MISO, SPIClass& _spi=SPI);
+		CC1101Radio(const byte _csn=SS,
+		const byte _miso=MISO, SPIClass& _spi=SPI, const uint32_t spiClock=CC1101_SPI_CLOCK);
+
+		// The SPI clock in Hz (see CC1101_SPI_CLOCK). The MCU uses the nearest lower clock it can.
+		void setSpiClock(const uint32_t spiClock);
 
 		byte readRegister(byte addr);
 		
 		bool begin(const uint32_t freq);
 
+		// Uses a register image calculated at compile time. See CC1101_Profile.h
+		// radio.begin< CC1101Profile<868300000, 38400, 20630> >();
+		template <class Profile> bool begin() {
+			if (!loadImage(Profile::registers)) return false;
+			writeImage(Profile::PATABLE);
+			return true;
+		}
+
 		// this is a sendPacket variant that should work with very low MCU clock rates and/or SPI bus speed.
 		// Fills the TX buffer before actually start the transmission.
 		// It cannot send packet with long preamble (to wake a remote WakeOnRadio chip)
@@ -217,6 +597,55 @@ class CC1101 {
 		// Sets the state to RX
 		byte getPacket(byte *packet);
 
+		// The chip stays in RX after a packet (MCSM1 RXOFF_MODE=RX) and getPacket() returns
+		// the packets of the FIFO one by one, without flushing it. Short packets sent back to back
+		// are not lost, and there is no IDLE->RX calibration after every packet.
+		// The FIFO is flushed only after an overflow. Sets the chip to IDLE state.
+		void enableMultiPacketRx();
+
+		// The default. The chip goes to IDLE after a packet and getPacket() flushes the FIFO.
+		// Sets the chip to IDLE state.
+		void disableMultiPacketRx();
+
+		// Packets larger than 61 bytes. The FIFO is refilled/read while the packet is on the air,
+		// using the FIFOTHR threshold (33 bytes TX, 32 bytes RX).
+		// infinite=false : up to 255 bytes (variable length mode, 1 length byte as the normal packets).
+		// infinite=true : up to 65533 bytes (infinite length mode). The packet starts with a 2 byte
+		// length, and the chip is switched to fixed length mode for the last bytes, so the CRC is
+		// checked as usual. Not compatible with the normal packets.
+		// Both modules must use the same setting. Sets the chip to IDLE state.
+		void enableLongPackets(const bool infinite=false);
+
+		// The default, up to 61 byte packets. Sets the chip to IDLE state.
+		void disableLongPackets();
+
+		// Sends a packet after enableLongPackets(). Returns after the packet is sent (true),
+		// or if other devices are talking (false). The MCU must keep up with the data rate, at
+		// least 1 byte per 8 bit periods. Sets the chip to RX state
+		bool sendLongPacket(const byte *txBuffer, const uint16_t size);
+
+		// Returns 0 immediately if no packet is arriving. Otherwise reads the packet while it
+		// is received and returns its size. Larger packets than bufSize are rejected.
+		// Check crcok() as with getPacket().
+		uint16_t getLongPacket(byte *rxBuffer, const uint16_t bufSize);
+
+		// Sends count packets (up to 61 bytes each) back to back, with one CCA for all of them.
+		// The chip stays in TX between the packets (MCSM1 TXOFF_MODE=TX, it sends preamble
+		// until the next packet is in the FIFO), and the FIFO is refilled with the next packets
+		// while the current one is on the air. There is no IDLE, flush and calibration between
+		// them. sent[i] (optional) is the result of every packet. Returns the packets sent,
+		// 0 if other devices are talking. The receiver must read the packets fast enough, see
+		// enableMultiPacketRx() and enableRxInterrupt(). Sets the chip to RX state.
+		// byte *packets[] = { log1, log2, log3 }; byte sizes[] = { 61, 61, 20 };
+		// radio.sendBatch(packets, sizes, 3);
+		byte sendBatch(const byte * const packets[], const byte sizes[], const byte count, bool sent[]=NULL);
+
+		// The same, the packets are made while the batch is sent. source(ctx, i, frame) copies
+		// the i-th packet to frame (61 bytes) and returns its size, with frame=NULL it returns
+		// only the size. It is called many times for the same packet, the size must not change.
+		// No RAM for all the packets, for example a large message split in fragments.
+		byte sendBatch(CC1101FrameSource source, void *ctx, const byte count, bool sent[]=NULL);
+
 		// Sends a strobe (1 byte command) to the CC1101 chip.
 		byte strobe(byte strobe);
 		
@@ -254,6 +683,16 @@ class CC1101 {
 		// Sets the chip to IDLE state.
 		void setBaudrate38000bps();
 
+		// Any data rate from 600bps to 500kbps. The deviation, the channel filter (MDMCFG4 CHANBW) and
+		// the modulation are calculated for the rate :
+		// up to 150kbps GFSK with 25KHz (<=4800bps) to datarate/2 deviation
+		// above 150kbps MSK
+		// 4800 and 38400 are close to the presets but the 38400 filter is wider (135KHz)
+		// Returns the actual data rate of the chip, which is very close to bps.
+		// Both modules must use the same bps, and higher rates need stronger signals.
+		// Sets the chip to IDLE state.
+		uint32_t setDataRate(uint32_t bps);
+
 		// set the baudrate, 4800 and 38000 only. The algo is crude, any number less than 10000 -> 4800bps
 		__attribute__((deprecated)) void setBaudrate(const uint16_t baudrate);
 		
@@ -300,12 +739,44 @@ class CC1101 {
 		void whitening(const bool w);
 		
 		// return the state of the chip CC1101 manual SWRS061I page 31
-		// we read 2 times because of errata notes.
+		// 2 reads must agree because of errata notes. The status byte of the
+		// previous SPI access counts as the first read.
 		byte getState();
 		
 		// Sets the frequency of the carrier signal. Sets the chip to IDLE state.
 		// No need to use it in setup as begin calls it internally
 		void setFrequency(const uint32_t freq);
+
+		// Channel plan for frequency hopping : the carrier is baseFreq + channel*spacing.
+		// spacing is 25-405KHz (MDMCFG1 MDMCFG0 CHANSPC), returns the spacing the chip uses.
+		// The channel is 0 and the cached calibrations are discarded. Sets the chip to IDLE state.
+		uint32_t setChannelPlan(const uint32_t baseFreq, uint32_t spacing);
+
+		// Changes the channel (CHANNR). Without cached calibrations the synthesizer calibrates
+		// (~800us) when the chip leaves IDLE, with calibrateChannels() the stored FSCAL values
+		// of the channel are written instead and setRXstate() is ~75us. Writes the chip even
+		// in deferred mode. Sets the chip to IDLE state, use setRXstate() after it.
+		void setChannel(const byte channel);
+		byte getChannel();
+
+		// Calibrates the channels 0..count-1 once and keeps FSCAL3 FSCAL2 FSCAL1 of each in cal[]
+		// (3 bytes per channel, the application owns the array). From now on the chip does not
+		// calibrate by itself (MCSM0 FS_AUTOCAL=0), setChannel() loads the values. The calibration
+		// depends on the temperature and the supply voltage, repeat it if they change much
+		// (TI DN505), or every few minutes. Takes ~1ms per channel. The channel does not change.
+		// Sets the chip to IDLE state.
+		void calibrateChannels(CC1101ChannelCal cal[], const byte count);
+		// The chip calibrates again when it leaves IDLE. Sets the chip to IDLE state.
+		void disableChannelCal();
+
+		// Channel occupancy scan, for a gateway choosing a quiet channel. For every channel
+		// first..first+count-1 the chip goes to RX, waits 2 RSSI update periods for the filter
+		// and reads the live RSSI register every period for dwellUs (at least one reading,
+		// 0=one period). dbm[i] is the strongest reading of channel first+i, so short bursts
+		// of traffic count. Returns the quietest channel. Use calibrateChannels() first, then a
+		// channel takes ~0.5ms at 4800bps instead of ~1.2ms. Packets received on the scanned
+		// channels are discarded (with enableRxInterrupt() they can reach the queue). Returns to the channel it had, in RX state.
+		byte scanChannels(const byte first, const byte count, int16_t dbm[], const uint16_t dwellUs=0);
 		
 		// Do not use it unless for interoperability with an already installed system
 		// the default syncWord has the best charasterics for packet detection
@@ -345,6 +816,45 @@ class CC1101 {
 		// sets the state to RX. 
 		bool sendPacket(const byte *txBuffer,const byte size, const uint32_t duration=0);
 
+		// Non blocking version of sendPacket(). Starts the transmission and returns immediately.
+		// The transmission advances with every poll() call, which should be called
+		// from loop() until it returns something other than CC1101_SEND_PENDING.
+		// txBuffer is read later by poll() and must remain valid until then.
+		// Returns false if the arguments are wrong.
+		// Do not call other functions of the module (getPacket etc) while the packet is pending.
+		bool beginSend(const byte *txBuffer, byte size, const uint32_t duration=0);
+
+		// Advances the transmission started by beginSend(). Every call costs a few
+		// SPI transactions at most, and never waits for the chip.
+		// Returns sendStatus()
+		byte poll();
+
+		// CC1101_SEND_PENDING CC1101_SEND_OK CC1101_SEND_CCA_FAIL etc.
+		// When the result is CC1101_SEND_OK the chip is going to RX state (it calibrates first).
+		byte sendStatus();
+
+		// Listen before talk with random backoff, for sendPacket() and beginSend()/poll().
+		// sendLongPacket() sendBatch() and sendWakeTrain() retry a busy CCA with the same
+		// backoffs (without the one before the first CCA), sendPacketSlowMCU() does not.
+		// Before every CCA the module waits a random time, 0 to 2^BE slots (see
+		// CC1101_CSMA_MIN_BE). When the channel is busy the packet is not dropped, BE grows
+		// and the module tries again, so many nodes that want to talk at the same time spread out.
+		// The send fails (CC1101_SEND_CCA_FAIL) after maxAttempts CCAs, or if the next try
+		// would be later than deadlineMs after the send call (0=no deadline). slotUs=0 is
+		// 8 byte times of the data rate, at least 500us. Also fails if a packet is received
+		// during a backoff (the chip is IDLE with the packet), so getPacket() can read it.
+		// The nodes must not share the random() sequence, call randomSeed() with something
+		// unique (the node address, analogRead() of a floating pin).
+		// The CCA is the chip's (MCSM1 CCA_MODE=3 : RSSI below threshold and no packet
+		// being received).
+		void enableCsma(const byte maxAttempts=5, const uint16_t deadlineMs=0, const uint16_t slotUs=0);
+
+		// The default. One CCA, sendPacket() returns false if the channel is busy.
+		void disableCsma();
+
+		// The CCAs of the last send, 1 if the channel was clear.
+		byte getSendAttempts();
+
 		// the same as the previous function but adds the addres to the start of the packet
 		//bool sendPacket(const byte addr, const byte *txBuffer, byte size, const uint32_t duration=0);
 
@@ -353,14 +863,141 @@ class CC1101 {
 		// present it is going for sleep and the cycle repeats.
 		void wor(uint16_t timeout=1000); //  1000ms=1sec cycle
 
+		// Calculates a WakeOnRadio setting, for a computed trade-off between latency and current.
+		// periodMs : the sleep cycle, 15ms to 17 hours (wor(uint16_t) stops at 1.89s).
+		// rxUs : the RX window (RX_TIME) when the chip hears a carrier, the shortest window of at
+		// least rxUs, or the longest one (RX_TIME=0). Without a carrier the chip sleeps again as
+		// soon as the RSSI is valid (RX_TIME_RSSI=1).
+		// event1 : 0-7, the crystal start up time 4-48 RC periods (wor() uses 7, 1.33ms).
+		// worRes : 0-3, the EVENT0 resolution. 0xFF=the finest for the period, a coarser one
+		// makes the RX windows shorter (SWRS061I table 31).
+		// Uses the current data rate and filter, call it after them.
+		CC1101WorConfig worConfig(uint32_t periodMs, const uint32_t rxUs=0, byte event1=7, byte worRes=0xFF);
+		// Sets the chip to WakeOnRadio state with a worConfig() setting
+		void wor(const CC1101WorConfig& config);
+
 		// Should be used immediatelly after WOR -> GDO0 assert
 		void wor2rx();
 
+		// Wakes WOR receivers with a train of short wake frames instead of a long preamble.
+		// Every frame has the number of frames until the payload, so the receiver (getWakePacket())
+		// sleeps again until the payload instead of listening to the rest of the preamble.
+		// durationMs : the wake preamble, CC1101WorConfig::preambleMs of the receiver. A frame is
+		// added for a receiver that wakes up in the middle of one.
+		// Returns false if the channel is busy or the TX FIFO underflows. Sets the chip to RX state.
+		bool sendWakeTrain(const byte *txBuffer, byte size, const uint32_t durationMs);
+
+		// The receiver of sendWakeTrain(), after GDO0 woke the MCU from WOR. Instead of
+		// wor2rx() and getPacket(). Reads the wake frame, sets the chip to SLEEP until the
+		// payload (with delay()) and receives it. Returns the size of the payload, 0 if it
+		// does not come. A packet with a long preamble (sendPacket() with duration) is also returned.
+		// The RX window must hold a wake frame, wor(worConfig(periodMs, wakeFrameUs())), so the
+		// period must be more than 8 wake frames.
+		byte getWakePacket(byte *rxBuffer);
+
+		// The time of a wake frame on the air, us
+		uint32_t wakeFrameUs();
+
+		// The time of a packet on the air with the current settings, us. size is the payload
+		// (up to 61). The preamble, sync word, length byte and CRC are included.
+		uint32_t frameUs(const byte size);
+
+		// With defer=true the setters (addresses, baudrate, power, frequency etc.) only
+		// remember the new values and the chip is configured by apply(). This way
+		// a gateway can change address and power per peer with a few SPI transactions and
+		// without leaving RX state more than once. The default is false, every setter
+		// writes the chip immediately.
+		// wor() always writes the chip, together with any pending change (it sets the chip
+		// to IDLE first). wor2rx() writes only the WOR registers, the rest wait for apply().
+		// In both modes a setter that does not change any value does not use the SPI bus
+		// and does not change the state of the chip.
+		void deferWrites(const bool defer);
+
+		// Writes the registers changed after the last apply() with burst transfers.
+		// If there are changes, the chip goes to IDLE and returns to RX if it was in RX before.
+		// Nothing is transfered if no setter changed a value.
+		void apply();
+
+		// Interrupt driven reception. On every GDO0 falling edge (end of packet) the packets
+		// are copied from the chip to the queue, with their RSSI LQI and CRC status. The application
+		// uses available() and read() which do not use the SPI bus at all.
+		// The chip stays in RX after a packet (MCSM1 RXOFF_MODE=RX) so packets sent
+		// by several nodes within a few ms are not lost.
+		// Only one module can use it. gdo0 must be a pin with interrupt capability (2 or 3 on Atmega328)
+		// The interrupt is registered with spi.usingInterrupt(), the other devices on the bus must
+		// use beginTransaction(). Not on ESP8266/ESP32, their cores have no usingInterrupt().
+		// Sets the chip to RX state
+		void enableRxInterrupt(const byte gdo0, CC1101RxQueueBase& queue);
+
+		// Returns to the normal getPacket() operation. The chip is in IDLE state.
+		void disableRxInterrupt();
+
+		// Number of packets in the queue
+		byte available();
+
+		// Copies the oldest packet of the queue to packet (at least 61 bytes) and returns the
+		// size. getRSSIdbm() getLQI() crcok() refer to this packet after the call.
+		// Returns 0 if the queue is empty.
+		byte read(byte *packet);
+
+		// The module updates the counters of stats (packets, CRC errors, CCA failures,
+		// FIFO flushes, SPI traffic etc). Without it the counters cost nothing
+		// but a pointer check.
+		void enableStats(CC1101Stats& s);
+		void disableStats();
+
+		// Counts the time the module spends in each state (CC1101Energy), to estimate the charge
+		// and the battery life. The library sees the state when it reads it (getState(), every
+		// send and receive function) and when it sends the chip to SLEEP or WOR, the changes
+		// the chip does alone (the end of a packet) are counted at the next getState(). micros()
+		// must not wrap between two updates (71 minutes), and with a sleeping MCU the application
+		// adds the sleep time with CC1101Energy::add(). Without it the time costs a pointer check.
+		void enableEnergy(CC1101Energy& e);
+		void disableEnergy();
+		// Counts the time of the current state until now, before reading CC1101Energy
+		void updateEnergy();
+
+		// Fast TX<->RX turnaround, for request/reply protocols. After a transmission the chip
+		// goes directly to RX (MCSM1 TXOFF_MODE=RX) and after a received packet it waits in
+		// FSTXON (RXOFF_MODE=FSTXON) with the synthesizer running, so the reply starts in
+		// ~30us instead of the ~800us of a calibration. sendPacket() does not wait the 500us
+		// before STX, and from FSTXON there is no CCA (the peer waits for the reply).
+		// After getPacket() returns a packet the chip is in FSTXON and does not receive, until
+		// sendPacket() or the next getPacket()/setRXstate() puts it in RX (~30us).
+		// The synthesizer is calibrated only when the chip passes from IDLE, the library does
+		// this every calEvery-th send/receive (0=never, the setters still pass from IDLE).
+		// Works with enableMultiPacketRx() and enableRxInterrupt(), then the chip stays in RX
+		// after a packet as before. Sets the chip to IDLE state.
+		void enableFastTurnaround(const byte calEvery=4);
+		void disableFastTurnaround();
+
+		// us from the last beginSend()/sendPacket() call until the chip is transmitting.
+		// This is the reply latency of a request/reply protocol, with fast turnaround or not.
+		uint32_t getTurnaroundUs();
+
 		// This is the buffer size of the CC1101 fifo. This library limits the payload to 61 bytes,
 		// the other 3 bytes are for CRC-OK and LQI-RSSI report
 		static const byte BUFFER_SIZE = 64;
 };
 
+// The module with the pins known at runtime
+typedef CC1101Radio<CC1101Pins> CC1101;
+
+// The same as CC1101 but the pins are known at compile time. Every register access
+// toggles CSN twice and reads MISO at least once, and the port access of CC1101_FastPin.h
+// is inlined there instead of digitalWrite/digitalRead (~10us per register access).
+// It is another class than CC1101 : CC1101Arq and CC1101Frag take a CC1101.
+// CC1101T<10> radio; // CSN=10 MISO and SPI the defaults
+// CC1101T<PB12, PB14, spi2> radio;
+template <byte CSN, byte MISO_PIN=MISO, SPIClass& BUS=SPI>
+class CC1101T : public CC1101Radio< CC1101FastPins<CSN, MISO_PIN> > {
+	public:
+		CC1101T(const uint32_t spiClock=CC1101_SPI_CLOCK)
+		: CC1101Radio< CC1101FastPins<CSN, MISO_PIN> >(CSN, MISO_PIN, BUS, spiClock) {}
+};
+
+#include "CC1101_RFImpl.h"
+
 #define CC1101_RF CC1101
 
-#endif
\ No newline at end of file
+#endif
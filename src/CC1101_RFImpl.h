@@ -0,0 +1,1945 @@
+/*
+(c) Panagiotis Karagiannis MIT Licenece
+
+The functions of CC1101Radio<Pins>. They are templates, the pins of CC1101T are known
+at compile time and the access is inlined in every SPI transaction. CC1101 (runtime pins)
+is compiled once, in CC1101_RF.cpp. The history of the code is in CC1101_RF.cpp.
+
+Included by CC1101_RF.h
+*/
+
+#ifndef CC1101_RFImpl_h
+#define CC1101_RFImpl_h
+
+#include <stdarg.h>
+
+// set the CC1101_DEBUG_PORT inside platformio.ini to have
+// debug output on CC1101_DEBUG_PORT
+#ifdef CC1101_DEBUG_PORT
+    #define CC1101_PRINTLN(x, ...) CC1101_DEBUG_PORT.println(x, ##__VA_ARGS__)
+    #define CC1101_PRINT(x, ...) CC1101_DEBUG_PORT.print(x, ##__VA_ARGS__)
+#else
+    #define CC1101_PRINTLN(x, ...) do {} while (0)
+    #define CC1101_PRINT(x, ...) do {} while (0)
+#endif
+
+#define     CC1101_WRITE_BURST      0x40                    //write burst
+#define     CC1101_READ_SINGLE      0x80                    //read single
+#define     CC1101_READ_BURST       0xC0                    //read burst
+#define     CC1101_BYTES_IN_RXFIFO  0x7F                    //byte number in RXfifo
+
+// CC1101Stats counter, if enableStats() is used
+#define     CC1101_STAT(field, n)   do { if (stats) stats->field += (n); } while (0)
+
+#ifdef CC1101_TRACE
+    #define CC1101_TRACE_EVENT(event, arg) do { trace(CSNpin, event, arg, chipStatus); } while (0)
+#else
+    #define CC1101_TRACE_EVENT(event, arg) do {} while (0)
+#endif
+
+template <class Pins>
+CC1101Radio<Pins>::CC1101Radio(const byte _csn, byte wiredToMisoPin, SPIClass& _spi, const uint32_t spiClock)
+: txStage(TX_NONE), sendResult(CC1101_SEND_NONE), txAttempts(0), csmaMaxAttempts(0), turnaroundUs(0), fastTurnaround(false), turnCalEvery(0),
+  turnCount(0), paTable(0), paDirty(false), deferred(false), sleepLost(false),
+  CSNpin(_csn),MISOpin(wiredToMisoPin), spi(_spi), spiSettings(spiClock, MSBFIRST, SPI_MODE0),
+  sleepStrobe(CC1101_SPWD), rxQueue(NULL), rxSize(0), chipStatus(CC1101_STATUS_UNKNOWN), channelCal(NULL),
+  channelCalCount(0), stats(NULL), energy(NULL), energyState(0), energySince(0), traceState(0xFF) {
+    memset(dirty, 0, sizeof(dirty));
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::setSpiClock(const uint32_t spiClock) {
+    spiSettings = SPISettings(spiClock, MSBFIRST, SPI_MODE0);
+}
+
+// The buffer form of transfer() is used everywhere. Platforms with SPI FIFO/DMA
+// (STM32 ESP8266 ESP32) send the bytes back to back, and AVR saves the call per byte.
+
+// writes a byte to a register address
+template <class Pins>
+void CC1101Radio<Pins>::writeRegister(byte addr, byte value) {
+    byte buf[2] = { addr, value };
+    chipSelect();
+    waitMiso();
+    spi.transfer(buf, 2);
+    chipStatus = buf[0];
+    CC1101_STAT(spiBytes, 2);
+    chipDeselect();
+    if (addr==CC1101_TXFIFO) CC1101_TRACE_EVENT(CC1101_TRACE_FIFO_WR, 1);
+}
+
+// writes a buffer to a register address
+template <class Pins>
+void CC1101Radio<Pins>::writeBurstRegister(byte addr, const byte *buffer, byte num) {
+    byte temp = addr | CC1101_WRITE_BURST;
+#ifdef CC1101_TRACE
+    byte fifoBytes = num;
+#endif
+    chipSelect();
+    waitMiso();
+    chipStatus = spi.transfer(temp);
+    CC1101_STAT(spiBytes, 1+num);
+#if defined(ESP8266) || defined(ESP32)
+    spi.writeBytes(buffer, num);
+#else
+    // transfer(buf, n) overwrites the buffer with the received bytes
+    byte copy[BUFFER_SIZE];
+    while (num) {
+        byte n = num<BUFFER_SIZE ? num : BUFFER_SIZE;
+        memcpy(copy, buffer, n);
+        spi.transfer(copy, n);
+        buffer += n;
+        num -= n;
+    }
+#endif
+    chipDeselect();
+    if (addr==CC1101_TXFIFO) CC1101_TRACE_EVENT(CC1101_TRACE_FIFO_WR, fifoBytes);
+}
+
+// sends a strobe(a command) to CC1101
+template <class Pins>
+byte CC1101Radio<Pins>::strobe(byte strobe) {
+    chipSelect();
+    waitMiso();
+    byte reply = spi.transfer(strobe);
+    CC1101_STAT(spiBytes, 1);
+    if (strobe==CC1101_SFRX) CC1101_STAT(rxFlushes, 1);
+    else if (strobe==CC1101_SFTX) CC1101_STAT(txFlushes, 1);
+    // The reply is the state before the strobe. Commands that change the state
+    // invalidate it, getState() reads the status twice after them.
+    chipStatus = strobe==CC1101_SNOP ? reply : CC1101_STATUS_UNKNOWN;
+    if (strobe==CC1101_SPWD || strobe==CC1101_SWOR || strobe==CC1101_SXOFF) sleepStrobe = strobe;
+    else if (strobe!=CC1101_SNOP && strobe!=CC1101_SFRX && strobe!=CC1101_SFTX) sleepStrobe = 0;
+    if (energy) {
+        if (strobe==CC1101_SPWD) countState(CC1101Energy::SLEEP);
+        else if (strobe==CC1101_SWOR) countState(CC1101Energy::WOR);
+    }
+    chipDeselect();
+    if (strobe!=CC1101_SNOP) CC1101_TRACE_EVENT(CC1101_TRACE_STROBE, strobe);
+    return reply;
+}
+
+// readRegister reads data from register address
+template <class Pins>
+byte CC1101Radio<Pins>::readRegister(byte addr) {
+    byte buf[2] = { (byte)(addr|CC1101_READ_SINGLE), 0 }; // bit 7 is set for signe register read
+    chipSelect();
+    waitMiso();
+    spi.transfer(buf, 2);
+    chipStatus = buf[0];
+    CC1101_STAT(spiBytes, 2);
+    chipDeselect();
+    if (addr==CC1101_RXFIFO) CC1101_TRACE_EVENT(CC1101_TRACE_FIFO_RD, 1);
+    return buf[1];
+}
+
+// readBurstRegister reads burst data from register address
+// and stores the data to buffer
+template <class Pins>
+void CC1101Radio<Pins>::readBurstRegister(byte addr, byte *buffer, byte num) {
+    byte temp = addr | CC1101_READ_BURST;
+    chipSelect();
+    waitMiso();
+    chipStatus = spi.transfer(temp);
+    CC1101_STAT(spiBytes, 1+num);
+    // the chip ignores MOSI during a burst read, the buffer is sent as is
+    if (num) spi.transfer(buffer, num);
+    chipDeselect();
+    if (addr==CC1101_RXFIFO) CC1101_TRACE_EVENT(CC1101_TRACE_FIFO_RD, num);
+}
+
+// readStatus : read status register
+template <class Pins>
+byte CC1101Radio<Pins>::readStatusRegister(byte addr) {
+    byte buf[2] = { (byte)(addr|CC1101_READ_BURST), 0 };
+    chipSelect();
+    waitMiso();
+    spi.transfer(buf, 2);
+    chipStatus = buf[0];
+    CC1101_STAT(spiBytes, 2);
+    chipDeselect();
+    return buf[1];
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::reset (void) {
+    csnHigh(); // not chipDeselect(), there is no transaction yet
+    delayMicroseconds(50);
+    chipSelect();
+    delayMicroseconds(50);
+    chipDeselect();
+    delayMicroseconds(50);
+    chipSelect();
+    while (misoHigh());
+    spi.transfer(CC1101_SRES);
+    CC1101_STAT(spiBytes, 1);
+    while (misoHigh()); // the reset is complete
+    sleepStrobe = 0;
+    chipStatus = CC1101_STATUS_UNKNOWN;
+    chipDeselect();
+}
+
+// Resets the chip and loads a register image (from flash) to regs[]
+// returns false if the chip is not present
+template <class Pins>
+bool CC1101Radio<Pins>::loadImage(const byte *image) {
+    pinMode(MISOpin, INPUT);
+    //pinMode(GDO0pin, INPUT);
+    pinMode(CSNpin, OUTPUT);
+    reset();
+    // Check the version of the Chip as reported by the chip itself
+    // Should be 20 and this guves us a way to check if the CC1101 is 
+    // indeeed wireed corretly
+    byte version = readStatusRegister(CC1101_VERSION);
+    // CC1101 is not present or the wiring/pins is wrong
+    if (version<20) return false;
+    for (byte i=0; i<CC1101_CONFIG_SIZE; i++) regs[i] = pgm_read_byte(&image[i]);
+    // the image has FS_AUTOCAL=1
+    channelCal = NULL;
+    channelCalCount = 0;
+    return true;
+}
+
+// All the configuration registers are written with a single burst. The chip
+// is in IDLE after the reset so no state change is needed.
+// The same values stay in regs[] for the setters.
+template <class Pins>
+void CC1101Radio<Pins>::writeImage(const byte pa) {
+    writeBurstRegister(CC1101_IOCFG2, regs, CC1101_CONFIG_SIZE);
+    memset(dirty, 0, sizeof(dirty));
+    // setPower10dbm() etc are not used as they can be deferred
+    paTable = pa;
+    paDirty = false;
+    writeRegister(CC1101_PATABLE, paTable);
+}
+
+// CC1101 pin & registers initialization
+// The default profile (4800bps 10dbm) with the frequency calculated at runtime.
+template <class Pins>
+bool CC1101Radio<Pins>::begin(const uint32_t freq) {
+    if (!loadImage(CC1101Preset4800::registers)) return false;
+    frequencyToRegisters(freq, &regs[CC1101_FREQ2]);
+    writeImage(CC1101Preset4800::PATABLE);
+    return true;
+}
+
+// Only the RAM copy changes here. commit() or apply() write the chip.
+template <class Pins>
+void CC1101Radio<Pins>::setRegister(byte addr, byte value) {
+    if (regs[addr]==value) return;
+    regs[addr] = value;
+    dirty[addr>>3] |= 1<<(addr&7);
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::setPaTable(byte value) {
+    if (paTable==value) return;
+    paTable = value;
+    if (deferred) paDirty=true;
+    else writeRegister(CC1101_PATABLE, paTable); // no need for IDLE
+}
+
+template <class Pins>
+bool CC1101Radio<Pins>::isDirty() {
+    for (byte i=0; i<sizeof(dirty); i++) {
+        if (dirty[i]) return true;
+    }
+    return false;
+}
+
+// The chip resets 0x29-0x2E in SLEEP. regs[] keeps the values the chip should have, now
+// marked dirty, so a setter with the same value does not skip them.
+template <class Pins>
+void CC1101Radio<Pins>::markSleepLost() {
+    for (byte addr=CC1101_FSTEST; addr<=CC1101_TEST0; addr++) dirty[addr>>3] |= 1<<(addr&7);
+    sleepLost = true;
+}
+
+// In IDLE, after a wake up
+template <class Pins>
+void CC1101Radio<Pins>::restoreSleepLost() {
+    if (!sleepLost) return;
+    sleepLost = false;
+    writeBurstRegister(CC1101_FSTEST, &regs[CC1101_FSTEST], CC1101_TEST0-CC1101_FSTEST+1);
+    for (byte addr=CC1101_FSTEST; addr<=CC1101_TEST0; addr++) dirty[addr>>3] &= ~(1<<(addr&7));
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::writeDirty(const byte first, const byte end) {
+    byte addr=first;
+    while (addr<end) {
+        if ( (dirty[addr>>3] & (1<<(addr&7))) == 0 ) {
+            addr++;
+            continue;
+        }
+        byte run=addr;
+        while (addr<end && (dirty[addr>>3] & (1<<(addr&7))) ) {
+            dirty[addr>>3] &= ~(1<<(addr&7));
+            addr++;
+        }
+        if (addr-run==1) writeRegister(run, regs[run]);
+        else writeBurstRegister(run, &regs[run], addr-run);
+    }
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::commit() {
+    if (deferred || !isDirty()) return;
+    setIDLEstate();
+    writeDirty();
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::deferWrites(const bool defer) {
+    deferred = defer;
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::apply() {
+    if (paDirty) {
+        writeRegister(CC1101_PATABLE, paTable);
+        paDirty=false;
+    }
+    if (!isDirty()) return;
+    byte state = getState();
+    setIDLEstate();
+    writeDirty();
+    if (state==1) setRXstate();
+}
+
+template <class Pins>
+bool CC1101Radio<Pins>::sendPacketSlowMCU(const byte *txBuffer,byte size) {
+    if (txBuffer==NULL || size==0) {
+        CC1101_PRINTLN("sendPacket called with wrong arguments");
+        return false;
+    }
+    if (size>MAX_PACKET_LEN) {
+        CC1101_PRINTLN("Warning, packet truncated to max packet length");
+        size=MAX_PACKET_LEN;
+    }
+    CC1101_TRACE_EVENT(CC1101_TRACE_SEND, size);
+    byte txbytes = readStatusRegister(CC1101_TXBYTES); // contains Bit:8 FIFO_UNDERFLOW + other bytes FIFO bytes
+    if (txbytes!=0 || getState()!=1 ) {
+        if (txbytes) CC1101_PRINTLN("BYTES IN TX");
+        setIDLEstate();
+        strobe(CC1101_SFTX);
+        strobe(CC1101_SFRX);
+        setRXstate();
+    }
+    writeRegister(CC1101_TXFIFO, size);
+    writeBurstRegister(CC1101_TXFIFO, txBuffer, size); //write data to send
+    delayMicroseconds(500);
+    strobe(CC1101_STX);
+    byte state = getState();
+    // We poll the state of the chip (state byte)
+    // until state==IDLE_STATE==0
+    // note that due to library setting the chip return to IDLE after TX
+    if (state==1) {
+        // high RSSI
+        // NOTE leaves the payload in the packet
+        // No IDLE strobe here, we have potentially an incoming packet.
+        CC1101_STAT(ccaFails, 1);
+        CC1101_PRINTLN("send=false");
+        return false;
+    } else  {
+        while(1) {
+            state = getState();
+            if (txEnded(state)) break; // TXOFF_MODE IDLE or RX
+            delayMicroseconds(byteTime());
+        }
+    }
+    if (state==0) {
+        setIDLEstate();
+        strobe(CC1101_SFTX);
+        setRXstate();
+    }
+    CC1101_STAT(packetsSent, 1);
+    CC1101_PRINTLN("true");
+    return true;
+}
+
+// Expects a char buffer terminated with 0
+template <class Pins>
+bool CC1101Radio<Pins>::sendPacket(const char* msg) {
+    size_t msglen = strlen(msg);
+    return sendPacket((const byte*)msg, (byte)msglen);
+}
+
+// Sends the SRX strobe (if needed) and waits until the state actually goes RX
+// flushes FIFOs if needed
+template <class Pins>
+void CC1101Radio<Pins>::setRXstate(void) {
+    while(1) {
+        byte state=getState();
+        if      (state==0b001) break; // RX state = 1 SWRS061I doc page 31
+        else if (state==0b000) restoreSleepLost(); // IDLE, maybe after SLEEP
+        else if (state==0b100 || state==0b101) { // CALIBRATE SETTLING, SRX is already given
+            delayMicroseconds(50); // the calibration needs ~800us
+            continue;
+        }
+        else if (state==0b110) strobe(CC1101_SFRX);
+        else if (state==0b111) strobe(CC1101_SFTX);
+        strobe(CC1101_SRX);
+    }
+}
+
+// getPacket read sdata received from RXfifo. Assumes (1 byte PacketLength) + (payload) + (2bytes CRCok, RSSI, LQI)
+// requires a buffer with 64 bytes to store the data (max payload = 61)
+template <class Pins>
+byte CC1101Radio<Pins>::getPacket(byte *rxBuffer) {
+    if ( (regs[CC1101_MCSM1] & 0x0C) == 0x0C ) return getPacketMulti(rxBuffer);
+    byte state = getState();
+    if (state==1) { // RX
+        return 0;
+    }
+    byte rxbytes = readStatusRegister(CC1101_RXBYTES);
+    rxbytes = rxbytes & CC1101_BYTES_IN_RXFIFO;
+    byte size=0;
+    bool emptyFifo = rxbytes==0; // nothing to flush
+    if(rxbytes) {
+        size=readRegister(CC1101_RXFIFO);
+        if (size>0 && size<=MAX_PACKET_LEN) {
+            if ( (size+3)<=rxbytes ) { // TODO
+                readBurstRegister(CC1101_RXFIFO, rxBuffer, size);
+                readBurstRegister(CC1101_RXFIFO, status, 2);
+                countRx(status[1]);
+                byte rem=rxbytes-(size+3);
+                emptyFifo = rem==0;
+                if (rem>0) {
+                    CC1101_STAT(fifoLeftovers, 1);
+                    CC1101_PRINT("FIFO STILL HAS BYTES :");
+                    CC1101_PRINTLN(rem);
+                }
+            } else {
+                CC1101_STAT(wrongRxSize, 1);
+                CC1101_PRINTLN("size+3<=rxbytes");
+                size=0;
+            }
+        } else { 
+            CC1101_STAT(wrongRxSize, 1);
+            CC1101_PRINT("Wrong rx size=");
+            CC1101_PRINTLN(size);
+            size=0;
+        }
+    }
+    if (fastTurnaround && (state==3 || state==5) && emptyFifo && (size==0 || !turnaroundCalDue())) {
+        // RXOFF_MODE=FSTXON. The chip waits for the reply, or goes to RX without calibration
+        // (SETTLING : it is already going to RX)
+        if (size==0 && state==3) strobe(CC1101_SRX);
+    } else {
+        setIDLEstate();
+        strobe(CC1101_SFRX);
+        setRXstate();
+    }
+    if (size==0) memset(status,0,2); // sets the crc to be wrong and clears old LQI RSSI values
+    else CC1101_TRACE_EVENT(CC1101_TRACE_RECEIVED, size);
+    return size;
+}
+
+// RXOFF_MODE=RX, the chip is always in RX and the FIFO can have many packets.
+// PKTSTATUS.SFD is high while a packet is received. When it is low the FIFO has only complete
+// packets. The length byte of the next packet is kept in rxSize until all the bytes are in the FIFO.
+template <class Pins>
+byte CC1101Radio<Pins>::getPacketMulti(byte *rxBuffer) {
+    byte rxbytes = readFifoBytes(CC1101_RXBYTES);
+    if (rxbytes & 0x80) {
+        CC1101_STAT(rxOverflows, 1);
+        CC1101_PRINTLN("RX FIFO overflow");
+        flushRx();
+        return 0;
+    }
+    if (rxSize==0) {
+        if (rxbytes==0) return 0;
+        if (readStatusRegister(CC1101_PKTSTATUS) & 0x08) return 0; // a packet is on the air
+        rxSize = readRegister(CC1101_RXFIFO);
+        rxbytes--;
+        if (rxSize==0 || rxSize>MAX_PACKET_LEN) {
+            CC1101_STAT(wrongRxSize, 1);
+            CC1101_PRINT("Wrong rx size=");
+            CC1101_PRINTLN(rxSize);
+            flushRx();
+            return 0;
+        }
+    }
+    if (rxbytes<rxSize+2) {
+        rxbytes = readFifoBytes(CC1101_RXBYTES) & CC1101_BYTES_IN_RXFIFO;
+        if (rxbytes<rxSize+2) return 0;
+    }
+    byte size = rxSize;
+    rxSize = 0;
+    readBurstRegister(CC1101_RXFIFO, rxBuffer, size);
+    readBurstRegister(CC1101_RXFIFO, status, 2);
+    countRx(status[1]);
+    CC1101_TRACE_EVENT(CC1101_TRACE_RECEIVED, size);
+    return size;
+}
+
+// errata, RXBYTES TXBYTES must be read until 2 reads are the same.
+// At high data rates the FIFO changes faster than 2 reads (16us/byte at 500kbps), so
+// 2 reads with 1 byte difference are also accepted, and the first one is returned.
+// It is the safe value : fewer bytes to read from RX, fewer bytes to write to TX.
+template <class Pins>
+byte CC1101Radio<Pins>::readFifoBytes(const byte addr) {
+    byte fifobytes = readStatusRegister(addr);
+    byte r;
+    while ( (r=readStatusRegister(addr)) != fifobytes && r+1 != fifobytes && r != fifobytes+1 ) fifobytes = r;
+    return fifobytes;
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::flushRx() {
+    setIDLEstate();
+    strobe(CC1101_SFRX);
+    rxSize = 0;
+    setRXstate();
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::enableMultiPacketRx() {
+    setOffModes(true);
+    rxSize = 0;
+    commit();
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::disableMultiPacketRx() {
+    setOffModes(false);
+    rxSize = 0;
+    commit();
+}
+
+template <class Pins>
+uint16_t CC1101Radio<Pins>::byteTime() {
+    return 8000000ul / CC1101Calc::dataRate(regs[CC1101_MDMCFG4] & 0x0F, regs[CC1101_MDMCFG3]);
+}
+
+// The pin is the actual MISO pin EXCEPT when the MCU cannot digitalRead(MISO)
+// if SPI is active (esp8266). In this case we connect another pin with MISO
+// and we digitalRead this instead
+// MISO goes low immediately after CSN low, unless the chip sleeps (SPWD SWOR SXOFF).
+// The pin can also be GDO2, as CHIP_RDYn is the default IOCFG2 setting.
+template <class Pins>
+void CC1101Radio<Pins>::waitMiso() {
+    if (!sleepStrobe) return;
+    while (misoHigh());
+    // After SPWD and SXOFF the chip stays awake (IDLE). WOR puts it to sleep again
+    if (sleepStrobe!=CC1101_SWOR) sleepStrobe = 0;
+}
+
+// Drives CSN to LOW and according to the SPI standard,
+// CC1101 starts listening to SPI bus
+template <class Pins>
+void CC1101Radio<Pins>::chipSelect() {
+    inSpi = true;
+    CC1101_STAT(spiTransactions, 1);
+    spi.beginTransaction(spiSettings);
+    csnLow();
+}
+
+// Drives CSN HIGH and CC1101 ignores the SPI bus
+// TODO not quite drives MISO
+template <class Pins>
+void CC1101Radio<Pins>::chipDeselect() {
+    csnHigh();
+    spi.endTransaction();
+    inSpi = false;
+    // a GDO0 interrupt came during the transaction
+    if (rxPending && !rxDraining && rxDrain) rxDrain();
+}
+
+// settings from RF studio. This is the defauklt
+template <class Pins>
+void CC1101Radio<Pins>::optimizeSensitivity() {
+    setRegister(CC1101_FSCTRL1, 0x06);
+    setRegister(CC1101_MDMCFG2, 0x17); // 0b0-001-0-111 OptSensit-GFSK-MATCHESTER-32bitSyncWord+CarrSense
+    commit();
+    if (!deferred) setRXstate();
+}
+
+// the examples do not use this setting, sensitivity is more importand than 1-2mA
+template <class Pins>
+void CC1101Radio<Pins>::optimizeCurrent() {
+    setRegister(CC1101_FSCTRL1, 0x08);
+    setRegister(CC1101_MDMCFG2, 0x97); // 0b1-001-0-111  OptCurrent-GFSK-MATCHESTER-32bitSyncWord+CarrSense
+    commit();
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::disableAddressCheck() {
+    // two status bytes will be appended to the payload + no address check
+    setRegister(CC1101_PKTCTRL1,CC1101_PKTCTRL1_DEFAULT_VAL+0);
+    commit();
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::enableAddressCheck(byte addr) {
+    setRegister(CC1101_ADDR, addr);
+    // two status bytes will be appended to the payload + address check
+    setRegister(CC1101_PKTCTRL1, CC1101_PKTCTRL1_DEFAULT_VAL+1);
+    commit();
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::enableAddressCheckBcast(byte addr) {
+    setRegister(CC1101_ADDR, addr);
+    // two status bytes will be appended to the payload + address check + accept 0 address
+    setRegister(CC1101_PKTCTRL1, CC1101_PKTCTRL1_DEFAULT_VAL+2);
+    commit();
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::setBaudrate4800bps() {
+    // 0xC7 0x83 0x40
+    setModem(CC1101Preset4800::MDMCFG4, CC1101Preset4800::MDMCFG3, CC1101Preset4800::DEVIATN, CC1101_MOD_GFSK);
+    commit();
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::setBaudrate38000bps() {
+    // 0xCA 0x83 0x35
+    setModem(CC1101Preset38000::MDMCFG4, CC1101Preset38000::MDMCFG3, CC1101Preset38000::DEVIATN, CC1101_MOD_GFSK);
+    commit();
+}
+
+// The modem registers for a data rate. Only the RAM copy changes, the caller does commit()
+// Also sets the registers RF studio changes for data rates above 100kbps.
+template <class Pins>
+void CC1101Radio<Pins>::setModem(const byte mdmcfg4, const byte mdmcfg3, const byte deviatn, const byte modFormat) {
+    setRegister(CC1101_MDMCFG4, mdmcfg4);
+    setRegister(CC1101_MDMCFG3, mdmcfg3);
+    setRegister(CC1101_DEVIATN, deviatn);
+    // bit7 (DEM_DCFILT_OFF) is set by optimizeSensitivity() optimizeCurrent()
+    setRegister(CC1101_MDMCFG2, (regs[CC1101_MDMCFG2] & 0x8F) | modFormat);
+    // DRATE_E>=12 is more than 101kbps.
+    // TEST2 TEST1 improve sensitivity only up to 100kbps (SWRS061I page 92)
+    bool fast = (mdmcfg4 & 0x0F)>=12;
+    setRegister(CC1101_TEST2, fast ? 0x88 : 0x81);
+    setRegister(CC1101_TEST1, fast ? 0x31 : 0x35);
+    // The wide channel filters (MSK) need a higher IF frequency (RF studio 250kbps 500kbps)
+    // otherwise the optimizeSensitivity() optimizeCurrent() value stays
+    if (modFormat==CC1101_MOD_MSK) setRegister(CC1101_FSCTRL1, 0x0C);
+    else if (regs[CC1101_FSCTRL1]==0x0C) setRegister(CC1101_FSCTRL1, 0x06);
+}
+
+template <class Pins>
+uint32_t CC1101Radio<Pins>::setDataRate(uint32_t bps) {
+    if (bps<600) bps=600;
+    if (bps>500000) bps=500000;
+    byte e = CC1101Calc::drateE(bps);
+    byte m = CC1101Calc::drateM(bps);
+    if (bps>150000) {
+        // MSK for the highest rates as RF studio does. The deviation register is not
+        // used as such, and the filter is ~2*datarate (812KHz max)
+        setModem( (CC1101Calc::chanBwBits(2*bps)<<4) | e, m, 0x00, CC1101_MOD_MSK);
+    } else {
+        // GFSK. The deviation of the 4800bps preset (25KHz) for the low rates, modulation
+        // index ~1 for the higher. The filter must pass the signal (Carson rule datarate+2*deviation)
+        // plus ~40KHz for the crystal errors of the 2 modules, and never less than the 101KHz
+        // of the presets.
+        uint32_t dev = bps<=4800 ? 25390 : (bps/2>20630 ? bps/2 : 20630);
+        uint32_t bw = bps + 2*dev + 40000;
+        if (bw<101562) bw=101562;
+        setModem( (CC1101Calc::chanBwBits(bw)<<4) | e, m, CC1101Calc::deviatn(dev), CC1101_MOD_GFSK);
+    }
+    commit();
+    return CC1101Calc::dataRate(e, m);
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::setBaudrate(const uint16_t baudrate) {
+    if (baudrate >= 10000) setBaudrate38000bps();
+    else setBaudrate4800bps();
+}
+
+// 10mW
+template <class Pins>
+void CC1101Radio<Pins>::setPower10dbm() {
+    setPaTable(0xC5);
+}
+
+// 3.2mW
+template <class Pins>
+void CC1101Radio<Pins>::setPower5dbm() {
+    setPaTable(0x86);
+}
+
+// 1mW
+template <class Pins>
+void CC1101Radio<Pins>::setPower0dbm() {
+    setPaTable(0x50);
+}
+
+// reports the signal strength of the last received packet in dBm
+// it is always a negative number and can be -30 to -100 dbm sometimes even less.
+template <class Pins>
+int16_t CC1101Radio<Pins>::getRSSIdbm() {
+    return rssiToDbm(status[0]);
+}
+
+// the RSSI status register and the appended status byte have the same format
+template <class Pins>
+int16_t CC1101Radio<Pins>::rssiToDbm(const byte rssi) {
+    // from TI app note
+    uint8_t rssi_dec = rssi;
+    int16_t rssi_dBm;
+    // uint8_t rssi_offset = 74;
+    const int16_t rssi_offset = 74;
+    if (rssi_dec >= 128) {
+        rssi_dBm = (int16_t)((int16_t)(rssi_dec - 256) / 2) - rssi_offset;
+    } else {
+        rssi_dBm = (rssi_dec / 2) - rssi_offset;
+    }
+    return rssi_dBm;
+}
+
+// reports if the last packet has correct CRC
+template <class Pins>
+bool CC1101Radio<Pins>::crcok() {
+    return status[1]>>7;
+}
+
+// reports how easily the last packet is demodulated (is read)
+template <class Pins>
+uint8_t CC1101Radio<Pins>::getLQI() {
+    return status[1]&0b01111111;;
+    // return 0x3F - status[1]&0b01111111;;
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::setIDLEstate() {
+    strobe(CC1101_SIDLE);
+    while (getState()!=0); // wait until state is IDLE(=0)
+    restoreSleepLost();
+}
+
+template <class Pins>
+bool CC1101Radio<Pins>::printf(const char* fmt, ...) {
+    byte pkt[MAX_PACKET_LEN+1];
+    va_list args;
+    va_start(args, fmt);
+    // TODO vsnprintf_P gia avr
+    byte length = vsnprintf( (char*)pkt,MAX_PACKET_LEN+1, (const char*)fmt, args );
+    va_end(args);
+    if (length>MAX_PACKET_LEN) length=MAX_PACKET_LEN;
+    return sendPacket(pkt, length);
+}
+
+// Put CC1101 into power-down state.
+template <class Pins>
+void CC1101Radio<Pins>::setPowerDownState() {
+    setIDLEstate();
+    strobe(CC1101_SFRX); // Flush RX buffer
+    strobe(CC1101_SFTX); // Flush TX buffer
+    markSleepLost();
+    // Enter Power-down state
+    strobe(CC1101_SPWD);
+}
+
+// WHITE_DATA is bit 6. The other bits (LENGTH_CONFIG) are not changed
+template <class Pins>
+void CC1101Radio<Pins>::enableWhitening() {
+    setRegister(CC1101_PKTCTRL0, regs[CC1101_PKTCTRL0] | 0x40); // 0x45 WHITE_DATA=1 PKT_FORMAT=0(normal) CRC_EN=1 LENGTH_CONFIG=1(var len)
+    commit();
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::disableWhitening() {
+    setRegister(CC1101_PKTCTRL0, regs[CC1101_PKTCTRL0] & ~0x40); // 0x05 WHITE_DATA=0 PKT_FORMAT=0(normal) CRC_EN=1 LENGTH_CONFIG=1(var len)
+    commit();
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::whitening(const bool w) {
+    if (w) enableWhitening();
+    else enableWhitening();
+}
+
+// return the state of the chip SWRS061I page 31
+// The status byte can be wrong if it changes while it is read (errata), so 2 reads
+// must agree. The status byte of the last SPI access is the first read, most of
+// the time only 1 SNOP is needed.
+template <class Pins>
+byte CC1101Radio<Pins>::getState() {
+    byte old_state = chipStatus;
+    CC1101_STAT(stateReads, 1);
+    while(1) {
+        byte state = strobe(CC1101_SNOP);
+        CC1101_STAT(statePolls, 1);
+        // CHIP_RDYn and STATE. The low bits are the FIFO bytes (RX or TX, depends on the access)
+        if (((state^old_state) & 0xF0) == 0) {
+            state = (state>>4)&0b00111;
+            if (energy) {
+                // IDLE RX TX FSTXON CALIBRATE SETTLING RXFIFO_OVERFLOW TXFIFO_UNDERFLOW
+                static const byte energyStates[8] = { CC1101Energy::IDLE, CC1101Energy::RX, 0,
+                    CC1101Energy::FS, CC1101Energy::FS, CC1101Energy::FS, CC1101Energy::IDLE, CC1101Energy::IDLE };
+                countState(state==2 ? txState() : energyStates[state]);
+            }
+#ifdef CC1101_TRACE
+            if (state!=traceState) CC1101_TRACE_EVENT(CC1101_TRACE_STATE, state);
+            traceState = state;
+#endif
+            return state;
+        }
+        old_state=state;
+    }
+}
+
+// calculate the value that is written to the register for settings the base frequency
+// that the CC1101 should use for sending/receiving over the air.
+// freqRegs[0..2] = FREQ2 FREQ1 FREQ0
+template <class Pins>
+void CC1101Radio<Pins>::frequencyToRegisters(const uint32_t freq, byte *freqRegs) {
+    // Uses uint64_t as the <<16 overflows uint32_t
+    // however the division with 26000000 allows the final
+    // result to be uint32 again. For a constant frequency see CC1101Profile
+    uint32_t reg_freq = CC1101Calc::freqWord(freq);
+    //
+    // this is split into 3 bytes that are written to 3 different registers on the CC1101
+    freqRegs[0] = (reg_freq>>16) & 0xFF;   // FREQ2 high byte, bits 7..6 are always 0 for this register
+    freqRegs[1] = (reg_freq>>8) & 0xFF;    // FREQ1 middle byte
+    freqRegs[2] = reg_freq & 0xFF;         // FREQ0 low byte
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::setFrequency(const uint32_t freq) {
+    byte freqRegs[3];
+    frequencyToRegisters(freq, freqRegs);
+    // the cached calibrations are for the old frequency
+    if (channelCal) disableChannelCal();
+    setRegister(CC1101_CHANNR, 0);
+    setRegister(CC1101_FREQ2, freqRegs[0]);
+    setRegister(CC1101_FREQ1, freqRegs[1]);
+    setRegister(CC1101_FREQ0, freqRegs[2]);
+    commit();
+    #ifdef CC1101_DEBUG
+        CC1101_PRINT("FREQ2=");
+        CC1101_PRINTLN(freqRegs[0], HEX);
+        CC1101_PRINT("FREQ1=");
+        CC1101_PRINTLN(freqRegs[1], HEX);
+        CC1101_PRINT("FREQ0=");
+        CC1101_PRINTLN(freqRegs[2],HEX);
+        uint32_t realfreq=((uint32_t)freqRegs[0]<<16)+((uint32_t)freqRegs[1]<<8)+(uint32_t)freqRegs[2];
+        realfreq=((uint64_t)realfreq*CC1101_CRYSTAL_FREQUENCY)>>16;
+        CC1101_PRINT("Real frequency = ");
+        CC1101_PRINTLN(realfreq);
+    #endif
+}
+
+template <class Pins>
+uint32_t CC1101Radio<Pins>::setChannelPlan(const uint32_t baseFreq, uint32_t spacing) {
+    constexpr uint32_t minSpacing = CC1101Calc::chanSpacing(0, 0);
+    constexpr uint32_t maxSpacing = CC1101Calc::chanSpacing(3, 255);
+    if (spacing<minSpacing) spacing=minSpacing;
+    if (spacing>maxSpacing) spacing=maxSpacing;
+    byte e = CC1101Calc::chanSpcE(spacing);
+    byte m = CC1101Calc::chanSpcM(spacing);
+    setRegister(CC1101_MDMCFG1, (regs[CC1101_MDMCFG1] & 0xFC) | e);
+    setRegister(CC1101_MDMCFG0, m);
+    setFrequency(baseFreq); // channel 0, commit()
+    return CC1101Calc::chanSpacing(e, m);
+}
+
+// A hop is SIDLE, CHANNR and (with cached calibrations) a FSCAL3-FSCAL1 burst. CHANNR and
+// FSCAL are not adjacent, 2 transactions. regs[] keeps the begin() values for FSCAL.
+template <class Pins>
+void CC1101Radio<Pins>::setChannel(const byte channel) {
+    setIDLEstate();
+    regs[CC1101_CHANNR] = channel;
+    dirty[CC1101_CHANNR>>3] &= ~(1<<(CC1101_CHANNR&7));
+    writeRegister(CC1101_CHANNR, channel);
+    if (channelCal==NULL) return;
+    if (channel<channelCalCount) {
+        writeBurstRegister(CC1101_FSCAL3, channelCal[channel].fscal, 3);
+    } else {
+        // not in the cache, FS_AUTOCAL=0 so the library calibrates
+        strobe(CC1101_SCAL);
+        while (getState()!=0);
+    }
+}
+
+template <class Pins>
+byte CC1101Radio<Pins>::getChannel() {
+    return regs[CC1101_CHANNR];
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::calibrateChannels(CC1101ChannelCal cal[], const byte count) {
+    if (cal==NULL || count==0) return;
+    byte channel = regs[CC1101_CHANNR];
+    channelCal = NULL;
+    // pending settings (data rate etc) first, they are part of the calibration
+    setIDLEstate();
+    writeDirty();
+    for (byte i=0; i<count; i++) {
+        writeRegister(CC1101_CHANNR, i);
+        strobe(CC1101_SCAL);
+        while (getState()!=0); // ~720us, CALIBRATE state
+        readBurstRegister(CC1101_FSCAL3, cal[i].fscal, 3);
+    }
+    channelCal = cal;
+    channelCalCount = count;
+    setRegister(CC1101_MCSM0, regs[CC1101_MCSM0] & 0xCF); // FS_AUTOCAL=0
+    writeDirty();
+    setChannel(channel);
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::disableChannelCal() {
+    channelCal = NULL;
+    channelCalCount = 0;
+    setRegister(CC1101_MCSM0, (regs[CC1101_MCSM0] & 0xCF) | 0x10);
+    commit();
+}
+
+template <class Pins>
+uint16_t CC1101Radio<Pins>::rssiPeriodUs() {
+    // BWchannel = fxosc/(8*(4+M)*2^E), 8*2^FILTER_LENGTH samples
+    byte e = regs[CC1101_MDMCFG4]>>6;
+    byte m = (regs[CC1101_MDMCFG4]>>4) & 3;
+    byte filterLength = regs[CC1101_AGCCTRL0] & 3;
+    return ((uint64_t)(32ul*(4+m)<<(e+filterLength))*1000000 + CC1101_CRYSTAL_FREQUENCY-1) / CC1101_CRYSTAL_FREQUENCY;
+}
+
+template <class Pins>
+byte CC1101Radio<Pins>::scanChannels(const byte first, const byte count, int16_t dbm[], const uint16_t dwellUs) {
+    byte channel = regs[CC1101_CHANNR];
+    byte quietest = first;
+    if (dbm==NULL || count==0) return quietest;
+    uint16_t period = rssiPeriodUs();
+    for (byte i=0; i<count; i++) {
+        setChannel(first+i);
+        setRXstate();
+        delayMicroseconds(2*period);
+        int16_t level = -138;
+        uint32_t start = micros();
+        do {
+            int16_t d = rssiToDbm(readStatusRegister(CC1101_RSSI));
+            if (d>level) level = d;
+            if (micros()-start>=dwellUs) break;
+            delayMicroseconds(period);
+        } while (1);
+        dbm[i] = level;
+        if (level<dbm[quietest-first]) quietest = first+i;
+    }
+    setChannel(channel);
+    strobe(CC1101_SFRX);
+    setRXstate();
+    return quietest;
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::setSyncWord(byte sync0, byte sync1) {
+    setRegister(CC1101_SYNC0, sync0);
+    setRegister(CC1101_SYNC1, sync1);
+    commit();
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::setSyncWord10(byte sync1, byte sync0) {
+    setRegister(CC1101_SYNC1, sync1);
+    setRegister(CC1101_SYNC0, sync0);
+    commit();
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::setMaxPktSize(byte size) {
+    if (size<1) size=1;
+    if (size>MAX_PACKET_LEN) size=MAX_PACKET_LEN;
+    setRegister(CC1101_PKTLEN, size);
+    commit();
+}
+
+#ifdef CC1101_DEBUG
+template <class Pins>
+void CC1101Radio<Pins>::printRegs() {
+    CC1101_PRINT("WORCTRL=0x"); CC1101_PRINTLN(readRegister(CC1101_WORCTRL),HEX);
+    CC1101_PRINT("MCSM2=0x");CC1101_PRINTLN(readRegister(CC1101_MCSM2),HEX);
+    CC1101_PRINT("MCSM0=0x");CC1101_PRINTLN(readRegister(CC1101_MCSM0),HEX);
+    CC1101_PRINT("WOREVT0=0x");CC1101_PRINTLN(readRegister(CC1101_WOREVT0),HEX);
+    CC1101_PRINT("WOREVT1=0x");CC1101_PRINTLN(readRegister(CC1101_WOREVT1),HEX);
+}
+#endif
+
+template <class Pins>
+void CC1101Radio<Pins>::wor(uint16_t timeout) {
+    if (timeout<15) timeout=15; // CC1101 has an ERRATA note we should not WOR for less than 15ms
+    constexpr const uint16_t maxtimeout=750ul*0xffff/(CC1101_CRYSTAL_FREQUENCY/1000);
+    // timeout<=1890msec for 26Mhz crystal.
+    if (timeout>maxtimeout) timeout=maxtimeout;
+    //
+    // RC_CAL=1 probably is the RC counting event0 event1
+    // 0x78 EVENT1=7 ((1.333ms) 0x38-> EVENT1=3(346.15us) for 1sec WoR mean current difference is 2-4uA
+    // which is very small so 7 is the safest. TI APP NOTE gives example
+    // with event1=3 however the crystal must is known brand with known startup time ?
+    // 0x58 is probably very good 0.667 – 0.692 ms. I suppose most crustals can do this ?
+    // manual says that CHP_RDYn asserts in 150us but this depends on crystal type (or quality ?)
+    // we choose 7 to be sure
+    //
+    // 12.5% duty cycle (RX_TIME=0) but with LOW RSSI just reuturn to SLEEP (because RX_TIME_RSSI=1)
+    // so the actual power consumption will be very small unless of course the peer
+    // activates the module constantly
+    wor(worConfig(timeout, 0, 7, 0));
+}
+
+template <class Pins>
+CC1101WorConfig CC1101Radio<Pins>::worConfig(uint32_t periodMs, const uint32_t rxUs, byte event1, byte worRes) {
+    CC1101WorConfig c;
+    if (periodMs<15) periodMs=15; // ERRATA
+    if (event1>7) event1=7;
+    // EVENT0 = period*fxosc/(750*2^(5*WOR_RES)), 16 bits
+    if (worRes>3) {
+        worRes = 0;
+        while (worRes<3 && (uint64_t)periodMs*CC1101_CRYSTAL_FREQUENCY/(750000ull<<(5*worRes)) > 0xFFFF) worRes++;
+    }
+    uint64_t event0 = (uint64_t)periodMs*CC1101_CRYSTAL_FREQUENCY/(750000ull<<(5*worRes));
+    if (event0>0xFFFF) event0 = 0xFFFF;
+    if (event0==0) event0 = 1;
+    c.event0 = event0;
+    uint64_t periodUs = (event0*(750000000ull<<(5*worRes)) + CC1101_CRYSTAL_FREQUENCY/2) / CC1101_CRYSTAL_FREQUENCY;
+    c.periodMs = (periodUs+500)/1000;
+    // the shortest window of at least rxUs, RX_TIME 6 is the shortest
+    byte rxTime = 6;
+    uint32_t rxTimeout;
+    while (1) {
+        rxTimeout = (event0*pgm_read_word(&worRxTimeout[worRes][rxTime])*26000ull/
+            (CC1101_CRYSTAL_FREQUENCY/1000) + 500) / 1000;
+        if (rxTimeout>=rxUs || rxTime==0) break;
+        rxTime--;
+    }
+    c.rxTimeoutUs = rxTimeout;
+    c.worctrl = (event1<<4) | 0x08 | worRes; // RC_CAL=1
+    c.mcsm2 = 0x18 | rxTime;                 // RX_TIME_RSSI=1 RX_TIME_QUAL=1
+    // A wake up : the crystal starts (EVENT1), the synthesizer settles (and calibrates every
+    // 4th time, MCSM0 FS_AUTOCAL=3), and the chip is in RX until the RSSI is valid, or the
+    // RX window ends if there is a carrier.
+    static const byte event1Periods[8] = {4, 6, 8, 12, 16, 24, 32, 48};
+    uint32_t e1Us = xoscUs(750ul*event1Periods[event1]);
+    uint32_t calUs = xoscUs(18739);
+    uint32_t settleUs = xoscUs(1953);
+    uint32_t rssiUs = 2*rssiPeriodUs();
+    if (rssiUs>rxTimeout) rssiUs = rxTimeout;
+    // charge per period in nA*us
+    uint64_t awake = (uint64_t)e1Us*CC1101_IDLE_UA*1000 + (uint64_t)calUs*CC1101_FS_UA*1000/4 +
+        (uint64_t)settleUs*CC1101_FS_UA*1000;
+    uint32_t awakeUs = e1Us + calUs/4 + settleUs;
+    uint64_t sleep = (uint64_t)CC1101_SLEEP_WOR_NA*periodUs;
+    c.averageNa = (sleep + awake + (uint64_t)rssiUs*CC1101_RX_UA*1000 -
+        (uint64_t)CC1101_SLEEP_WOR_NA*(awakeUs+rssiUs)) / periodUs;
+    uint64_t busyUs = (uint64_t)rxTimeout+awakeUs>periodUs ? periodUs-awakeUs : rxTimeout;
+    c.busyNa = (sleep + awake + busyUs*CC1101_RX_UA*1000 -
+        (uint64_t)CC1101_SLEEP_WOR_NA*(awakeUs+busyUs)) / periodUs;
+    // The preamble covers a whole period (the RC oscillator is calibrated, 1%) and the
+    // wake up with a calibration, then the receiver hears the carrier and waits for the sync word.
+    c.preambleMs = (periodUs*101/100 + e1Us + calUs + settleUs + rssiUs + 999) / 1000;
+    return c;
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::wor(const CC1101WorConfig& config) {
+    CC1101_PRINTLN("WOR");
+    if (energy) energy->currentNa[CC1101Energy::WOR] = config.averageNa;
+    setRegister(CC1101_WORCTRL, config.worctrl);
+    setRegister(CC1101_MCSM2, config.mcsm2);
+    setRegister(CC1101_MCSM0,  0x38); // autocal every 4th time from rx/tx to idle
+    CC1101_PRINT("WOREVT0=");
+    CC1101_PRINTLN(config.event0 & 0xff, HEX);
+    CC1101_PRINT("WOREVT1=");
+    CC1101_PRINTLN(config.event0>>8, HEX);
+    setRegister(CC1101_WOREVT0, config.event0 & 0xff);
+    setRegister(CC1101_WOREVT1, config.event0>>8);
+    // 750*0x876A/26000000.0 =~ 1.0000 sec
+    // the registers are written even in deferred mode, with any pending change. SWOR is
+    // given in IDLE anyway, so the chip goes there first.
+    setIDLEstate();
+    writeDirty();
+    markSleepLost();
+    strobe(CC1101_SWOR);
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::wor2rx() {
+    setRegister(CC1101_WORCTRL,0xFB);
+    setRegister(CC1101_MCSM2, 0x07);
+    // FS_AUTOCAL=1, or 0 with calibrateChannels()
+    setRegister(CC1101_MCSM0, channelCal ? 0x08 : 0x18);
+    //setRegister(CC1101_IOCFG0, 0x01); // Rx report only. This is different than openelec and panstamp lib
+    setRegister(CC1101_WOREVT0, 0x6B); // probably not needed
+    setRegister(CC1101_WOREVT1, 0x87); // probably not needed
+    // The chip may be in RX with the packet that woke it, so only the WOR registers are
+    // written. MCSM1 between MCSM2 and MCSM0 can have a deferred change.
+    writeDirty(CC1101_MCSM2, CC1101_MCSM2+1);
+    writeDirty(CC1101_MCSM0, CC1101_MCSM0+1);
+    writeDirty(CC1101_WOREVT1, CC1101_WORCTRL+1);
+}
+
+// preamble, sync word, length byte, payload and CRC
+template <class Pins>
+uint32_t CC1101Radio<Pins>::frameUs(const byte size) {
+    static const byte preambleBytes[8] = {2, 3, 4, 6, 8, 12, 16, 24};
+    uint16_t bytes = preambleBytes[(regs[CC1101_MDMCFG1]>>4) & 7] +
+        ((regs[CC1101_MDMCFG2] & 3)==3 ? 4 : 2) + 1 + size + ((regs[CC1101_PKTCTRL0] & 0x04) ? 2 : 0);
+    return (uint64_t)bytes*8000000 / CC1101Calc::dataRate(regs[CC1101_MDMCFG4] & 0x0F, regs[CC1101_MDMCFG3]);
+}
+
+template <class Pins>
+uint32_t CC1101Radio<Pins>::wakeFrameUs() {
+    return frameUs(CC1101_WAKE_SIZE);
+}
+
+template <class Pins>
+bool CC1101Radio<Pins>::sendWakeTrain(const byte *txBuffer, byte size, const uint32_t durationMs) {
+    if (txBuffer==NULL || size==0) {
+        CC1101_PRINTLN("sendWakeTrain called with wrong arguments");
+        return false;
+    }
+    if (size>MAX_PACKET_LEN) {
+        CC1101_PRINTLN("Warning, packet truncated");
+        size=MAX_PACKET_LEN;
+    }
+    // The frames are back to back (sendFrames() keeps the FIFO full), so the receiver
+    // knows the time until the payload from the count. One more frame for a receiver that
+    // wakes up in the middle of a frame.
+    uint32_t us = wakeFrameUs();
+    uint32_t frames = ((uint64_t)durationMs*1000 + us-1) / us + 1;
+    if (frames>0xFFFE) frames = 0xFFFE;
+    WakeTrain w = { txBuffer, size, (uint16_t)frames };
+    return sendFrames(wakeFrame, &w, w.frames+1, NULL)==w.frames+1;
+}
+
+template <class Pins>
+byte CC1101Radio<Pins>::getWakePacket(byte *rxBuffer) {
+    wor2rx();
+    // The chip woke up from WOR to RX (or IDLE) with FSTEST-TEST0 at their reset values.
+    // TEST2-TEST0 set the RX sensitivity, so they are written before the train is heard.
+    restoreSleepLost();
+    // RXOFF_MODE=RX until the payload, the chip does not calibrate between the frames and
+    // hears the payload right after the last wake frame. regs[] keeps the normal value.
+    writeRegister(CC1101_MCSM1, regs[CC1101_MCSM1] | 0x0C);
+    rxSize = 0;
+    // the packet that woke the chip can be complete already (RXOFF_MODE=IDLE), the FIFO keeps it
+    if (getState()!=1) strobe(CC1101_SRX);
+    uint32_t frame = wakeFrameUs();
+    // The chip wakes up (the crystal, ~800us calibration) and listens one frame before the payload
+    uint32_t lead = frame + 2000;
+    // the frame that woke the chip is on the air
+    uint32_t waitUs = 2*frame + frameUs(MAX_PACKET_LEN);
+    uint32_t t = micros();
+    byte size = 0;
+    while (micros()-t<waitUs) {
+        size = getPacketMulti(rxBuffer);
+        if (size==0) {
+            delayMicroseconds(byteTime());
+            continue;
+        }
+        if (size!=CC1101_WAKE_SIZE || rxBuffer[0]!=CC1101_WAKE_ID) break;
+        size = 0;
+        if (!crcok()) continue; // the next frame comes in a frame time
+        // the payload starts after the frames that follow
+        uint32_t left = (rxBuffer[1] | (uint16_t)rxBuffer[2]<<8) * frame;
+        t = micros();
+        waitUs = left + 2*frame + frameUs(MAX_PACKET_LEN);
+        if (left>lead+frame) {
+            setPowerDownState();
+            rxSize = 0;
+            uint32_t sleepUs = left-lead;
+            delay(sleepUs/1000);
+            delayMicroseconds(sleepUs%1000);
+            restoreSleepLost(); // wakes the chip, IDLE
+            setRXstate();
+        }
+    }
+    writeRegister(CC1101_MCSM1, regs[CC1101_MCSM1]);
+    // the chip in RX with an empty FIFO, as after getPacket()
+    flushRx();
+    return size;
+}
+
+template <class Pins>
+bool CC1101Radio<Pins>::sendPacket(const byte *txBuffer, byte size, const uint32_t duration) {
+    if (!beginSend(txBuffer, size, duration)) return false;
+    while (poll()==CC1101_SEND_PENDING) {
+        if (txStage==TX_ON_AIR || txStage==TX_BACKOFF) delayMicroseconds(byteTime());
+    }
+    if (sendStatus()!=CC1101_SEND_OK) return false;
+    setRXstate(); // waits for the calibration
+    return true;
+}
+
+template <class Pins>
+bool CC1101Radio<Pins>::beginSend(const byte *txBuffer, byte size, const uint32_t duration) {
+    if (txBuffer==NULL || size==0) {
+        CC1101_PRINTLN("sendPacket called with wrong arguments");
+        sendResult = CC1101_SEND_ERROR;
+        return false;
+    }
+    if (size>MAX_PACKET_LEN) {
+        CC1101_PRINTLN("Warning, packet truncated");
+        size=MAX_PACKET_LEN;
+    }
+    CC1101_TRACE_EVENT(CC1101_TRACE_SEND, size);
+    turnaroundUs = micros();
+    prepareTx();
+    txData = txBuffer;
+    txSize = size;
+    txDuration = duration;
+    txTimer = micros();
+    txStart = millis();
+    txAttempts = 0;
+    txStage = TX_WAIT_CCA;
+    sendResult = CC1101_SEND_PENDING;
+    // nodes that send at the same moment (a broadcast, the same timer) do not check the
+    // channel at the same moment
+    if (csmaMaxAttempts) csmaBackoff();
+    return true;
+}
+
+// The TX FIFO must be empty and the chip in RX (for CCA), or FSTXON with enableFastTurnaround()
+template <class Pins>
+void CC1101Radio<Pins>::prepareTx() {
+    byte txbytes = readStatusRegister(CC1101_TXBYTES); // contains Bit:8 FIFO_UNDERFLOW + other bytes FIFO bytes
+    byte state = getState();
+    bool ready = state==1 || (fastTurnaround && state==3);
+    if (ready && fastTurnaround && turnaroundCalDue()) ready = false;
+    if (txbytes!=0 || !ready ) {
+        if (txbytes) CC1101_PRINTLN("BYTES IN TX");
+        else CC1101_PRINTLN("getState()!=RX");
+        setIDLEstate();
+        strobe(CC1101_SFTX);
+        strobe(CC1101_SFRX);
+        setRXstate();
+    }
+}
+
+template <class Pins>
+byte CC1101Radio<Pins>::poll() {
+    switch (txStage) {
+    case TX_BACKOFF:
+        if (micros()-txTimer<txBackoffUs) break;
+        if (getState()!=1 && readFifoBytes(CC1101_RXBYTES)) {
+            // a packet is received during the backoff, the application must read it
+            CC1101_STAT(ccaFails, 1);
+            CC1101_PRINTLN("send=false");
+            txStage = TX_NONE;
+            sendResult = CC1101_SEND_CCA_FAIL;
+            turnaroundUs = 0;
+            break;
+        }
+        prepareTx();
+        txTimer = micros();
+        txStage = TX_WAIT_CCA;
+        // fall through
+    case TX_WAIT_CCA:
+        // the original blocking code waited here 500us. it helps ?
+        if (!fastTurnaround && micros()-txTimer<500) break;
+        txAttempts++;
+        strobe(CC1101_STX);
+        // CC1101_RF lib has register IOCFG0==0x01 which is good for RX
+        // but does not give TX info. So we poll the state of the chip (state byte)
+        // until state=IDLE_STATE=0
+        // note that due to library setting the chip return to IDLE after TX
+        if (getState()==1) {
+            // high RSSI
+            // No IDLE strobe here, we have potentially an incoming packet.
+            if (csmaBackoff()) break;
+            CC1101_STAT(ccaFails, 1);
+            CC1101_PRINTLN("send=false");
+            txStage = TX_NONE;
+            sendResult = CC1101_SEND_CCA_FAIL;
+            turnaroundUs = 0;
+            break;
+        }
+        turnaroundUs = micros()-turnaroundUs;
+        // the chip sends preamble until the FIFO has data
+        txTimer = millis();
+        txStage = TX_PREAMBLE;
+        // fall through
+    case TX_PREAMBLE:
+        if (millis()-txTimer<txDuration) break;
+        writeRegister(CC1101_TXFIFO, txSize); // write the size of the packet
+        writeBurstRegister(CC1101_TXFIFO, txData, txSize); // write the packet data to txbuffer
+        txStage = TX_ON_AIR;
+        break;
+    case TX_ON_AIR:
+        if (fastTurnaround) {
+            if (!txEnded(getState())) break; // TXOFF_MODE=RX, the chip is in RX (or has a reply) already
+        } else {
+            if (getState()!=0) break; // we wait for IDLE state
+            // the chip is already IDLE (MCSM1 TXOFF_MODE). SRX without waiting for the calibration
+            strobe(CC1101_SFTX);
+            strobe(CC1101_SRX);
+        }
+        CC1101_STAT(packetsSent, 1);
+        CC1101_PRINTLN("true");
+        txStage = TX_NONE;
+        sendResult = CC1101_SEND_OK;
+        break;
+    }
+    return sendResult;
+}
+
+template <class Pins>
+byte CC1101Radio<Pins>::sendStatus() {
+    return sendResult;
+}
+
+// Before the first CCA and after a busy one. Schedules the next try if the attempts
+// and the deadline allow it.
+template <class Pins>
+bool CC1101Radio<Pins>::csmaBackoff() {
+    if (txAttempts>=csmaMaxAttempts) return false;
+    byte be = CC1101_CSMA_MIN_BE+txAttempts;
+    if (be>CC1101_CSMA_MAX_BE) be = CC1101_CSMA_MAX_BE;
+    uint32_t slot = csmaSlotUs;
+    if (slot==0) {
+        slot = 8ul*byteTime();
+        if (slot<500) slot = 500;
+    }
+    // not a whole number of slots, two nodes collide only if they check the channel
+    // within the RSSI response time
+    uint32_t wait = random((long)slot<<be);
+    if (csmaDeadlineMs && millis()-txStart+wait/1000>=csmaDeadlineMs) return false;
+    CC1101_STAT(backoffs, 1);
+    CC1101_STAT(backoffUs, wait);
+    txBackoffUs = wait;
+    txTimer = micros();
+    txStage = TX_BACKOFF;
+    return true;
+}
+
+// STX of the blocking senders, the TX FIFO is filled already. With enableCsma() a busy
+// CCA is retried after the backoffs of poll(), the FIFO keeps the data.
+template <class Pins>
+bool CC1101Radio<Pins>::csmaStx() {
+    txStart = millis();
+    txAttempts = 0;
+    while (1) {
+        txAttempts++;
+        strobe(CC1101_STX);
+        if (getState()!=1) return true;
+        if (!csmaBackoff()) return false;
+        txStage = TX_NONE; // csmaBackoff() schedules poll()
+        delay(txBackoffUs/1000);
+        delayMicroseconds(txBackoffUs%1000);
+        // a packet is received during the backoff, the application must read it
+        if (getState()!=1 && readFifoBytes(CC1101_RXBYTES)) return false;
+    }
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::enableCsma(const byte maxAttempts, const uint16_t deadlineMs, const uint16_t slotUs) {
+    csmaMaxAttempts = maxAttempts;
+    csmaDeadlineMs = deadlineMs;
+    csmaSlotUs = slotUs;
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::disableCsma() {
+    csmaMaxAttempts = 0;
+}
+
+template <class Pins>
+byte CC1101Radio<Pins>::getSendAttempts() {
+    return txAttempts;
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::enableRxInterrupt(const byte gdo0, CC1101RxQueueBase& queue) {
+    rxQueue = &queue;
+    rxPin = gdo0;
+    rxRadio = this;
+    rxDrain = drainRxRadio;
+    // RXOFF_MODE=RX the chip does not need recalibration after every packet
+    setOffModes(true);
+    // the deferred mode is ignored here, the interrupt needs this setting
+    setIDLEstate();
+    writeDirty();
+    strobe(CC1101_SFRX);
+    pinMode(rxPin, INPUT);
+    // The interrupt uses the SPI bus. The SPI library holds it during the transactions of
+    // the other devices (SD card, Ethernet), inSpi only protects the CC1101 transactions.
+#if !defined(ESP8266) && !defined(ESP32)
+    spi.usingInterrupt(digitalPinToInterrupt(rxPin));
+#endif
+    attachInterrupt(digitalPinToInterrupt(rxPin), rxIsr, FALLING);
+    setRXstate();
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::disableRxInterrupt() {
+    if (rxQueue==NULL) return;
+    detachInterrupt(digitalPinToInterrupt(rxPin));
+#ifdef SPI_HAS_NOTUSINGINTERRUPT
+    spi.notUsingInterrupt(digitalPinToInterrupt(rxPin));
+#endif
+    rxQueue = NULL;
+    rxRadio = NULL;
+    rxDrain = NULL;
+    rxPending = false;
+    setOffModes(false);
+    setIDLEstate();
+    writeDirty();
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::rxIsr() {
+#ifdef CC1101_TRACE
+    if (rxRadio) trace(rxRadio->CSNpin, CC1101_TRACE_GDO0, 0, rxRadio->chipStatus);
+#endif
+    if (rxRadio) rxRadio->rxInterrupt();
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::drainRxRadio() {
+    rxRadio->drainRxFifo();
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::rxInterrupt() {
+    // We cannot use SPI if the main program is talking to the chip
+    if (inSpi || rxDraining) {
+        rxPending = true;
+        return;
+    }
+    rxPending = true;
+    drainRxFifo();
+}
+
+// Reads the complete packets of the RX FIFO to the queue.
+// Every GDO0 falling edge is a complete packet. If GDO0 is LOW no packet is being
+// received and all the bytes of the FIFO are complete packets.
+template <class Pins>
+void CC1101Radio<Pins>::drainRxFifo() {
+    rxDraining = true;
+    // an interrupt can come after the last check of rxPending, but before rxDraining=false
+    // then rxPending remains true for the next chipDeselect() or interrupt
+    while (rxPending) {
+        rxPending = false;
+        bool first = true;
+        while (first || digitalRead(rxPin)==LOW) {
+            first = false;
+            byte rxbytes = readFifoBytes(CC1101_RXBYTES);
+            if (rxbytes & 0x80) {
+                CC1101_STAT(rxOverflows, 1);
+                CC1101_PRINTLN("RX FIFO overflow");
+                strobe(CC1101_SIDLE);
+                strobe(CC1101_SFRX);
+                strobe(CC1101_SRX);
+                break;
+            }
+            rxbytes &= CC1101_BYTES_IN_RXFIFO;
+            if (rxbytes==0) break;
+            byte size = readRegister(CC1101_RXFIFO);
+            if (size==0 || size>MAX_PACKET_LEN || size+3>rxbytes) {
+                CC1101_STAT(wrongRxSize, 1);
+                CC1101_PRINT("Wrong rx size=");
+                CC1101_PRINTLN(size);
+                strobe(CC1101_SIDLE);
+                strobe(CC1101_SFRX);
+                strobe(CC1101_SRX);
+                break;
+            }
+            byte head = rxQueue->head;
+            byte next = head+1;
+            if (next==rxQueue->size) next = 0;
+            if (next==rxQueue->tail) {
+                // full, the packet is read from the FIFO and dropped
+                byte tmp[MAX_PACKET_LEN+2];
+                readBurstRegister(CC1101_RXFIFO, tmp, size+2);
+                countRx(tmp[size+1]);
+                rxQueue->dropped++;
+                continue;
+            }
+            CC1101Packet& p = rxQueue->slots[head];
+            p.size = size;
+            readBurstRegister(CC1101_RXFIFO, p.data, size);
+            readBurstRegister(CC1101_RXFIFO, p.status, 2);
+            countRx(p.status[1]);
+            rxQueue->head = next;
+        }
+    }
+    rxDraining = false;
+}
+
+template <class Pins>
+byte CC1101Radio<Pins>::available() {
+    if (rxQueue==NULL) return 0;
+    int n = (int)rxQueue->head - rxQueue->tail;
+    if (n<0) n += rxQueue->size;
+    return n;
+}
+
+template <class Pins>
+byte CC1101Radio<Pins>::read(byte *packet) {
+    if (rxQueue==NULL) return 0;
+    byte tail = rxQueue->tail;
+    if (tail==rxQueue->head) return 0;
+    CC1101Packet& p = rxQueue->slots[tail];
+    byte size = p.size;
+    memcpy(packet, p.data, size);
+    status[0] = p.status[0];
+    status[1] = p.status[1];
+    tail++;
+    if (tail==rxQueue->size) tail = 0;
+    rxQueue->tail = tail;
+    CC1101_TRACE_EVENT(CC1101_TRACE_RECEIVED, size);
+    return size;
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::enableLongPackets(const bool infinite) {
+    // FIFO_THR=7 the TX FIFO is refilled when it has 33 bytes or less, and the RX FIFO
+    // is read when it has 32 bytes or more. ADC_RETENTION as before
+    setRegister(CC1101_FIFOTHR, 0x47);
+    setRegister(CC1101_PKTLEN, 255);
+    // LENGTH_CONFIG 1=variable 2=infinite
+    setRegister(CC1101_PKTCTRL0, (regs[CC1101_PKTCTRL0] & 0xFC) | (infinite ? 2 : 1));
+    commit();
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::disableLongPackets() {
+    setRegister(CC1101_FIFOTHR, 0x4F);
+    setRegister(CC1101_PKTLEN, MAX_PACKET_LEN);
+    setRegister(CC1101_PKTCTRL0, (regs[CC1101_PKTCTRL0] & 0xFC) | 1);
+    commit();
+}
+
+// PKTLEN and LENGTH_CONFIG change while the packet is on the air. No IDLE here.
+template <class Pins>
+void CC1101Radio<Pins>::writeRegisterNow(const byte addr, const byte value) {
+    regs[addr] = value;
+    writeRegister(addr, value);
+}
+
+// In infinite mode the chip is switched to fixed length mode when less than 256 bytes
+// remain, and ends the packet when the byte counter (modulo 256) reaches PKTLEN (TI DN500).
+// "remaining" are the bytes not yet sent/received by the chip.
+template <class Pins>
+void CC1101Radio<Pins>::switchToFixedLength(const uint16_t remaining, bool &fixed) {
+    if (fixed || remaining>=256) return;
+    writeRegisterNow(CC1101_PKTCTRL0, regs[CC1101_PKTCTRL0] & 0xFC);
+    fixed = true;
+}
+
+template <class Pins>
+bool CC1101Radio<Pins>::sendLongPacket(const byte *txBuffer, const uint16_t size) {
+    bool infinite = (regs[CC1101_PKTCTRL0] & 3)==2;
+    if (txBuffer==NULL || size==0 || (!infinite && size>255) || size>0xFFFD) {
+        CC1101_PRINTLN("sendLongPacket called with wrong arguments");
+        return false;
+    }
+    CC1101_TRACE_EVENT(CC1101_TRACE_SEND, size>255 ? 255 : size);
+    prepareTx();
+    // the length is 1 byte (variable) or 2 bytes (infinite, the receiver needs it)
+    byte header[2];
+    byte headerLen;
+    bool fixed = !infinite;
+    if (infinite) {
+        header[0] = size>>8;
+        header[1] = size & 0xFF;
+        headerLen = 2;
+        writeRegisterNow(CC1101_PKTLEN, (size+2) & 0xFF);
+        switchToFixedLength(size+2, fixed);
+    } else {
+        header[0] = size;
+        headerLen = 1;
+    }
+    // The FIFO is filled before STX, the chip starts with a full FIFO
+    uint16_t sent = BUFFER_SIZE-headerLen;
+    if (sent>size) sent = size;
+    writeBurstRegister(CC1101_TXFIFO, header, headerLen);
+    writeBurstRegister(CC1101_TXFIFO, txBuffer, sent);
+    bool ok = true;
+    if (!csmaStx()) {
+        // high RSSI. The FIFO is flushed by the next send
+        CC1101_STAT(ccaFails, 1);
+        CC1101_PRINTLN("send=false");
+        ok = false;
+    } else {
+        byte threshold = 61 - 4*(regs[CC1101_FIFOTHR] & 0x0F);
+        while (sent<size) {
+            byte txbytes = readFifoBytes(CC1101_TXBYTES);
+            if (txbytes & 0x80) {
+                CC1101_PRINTLN("TX FIFO underflow");
+                ok = false;
+                break;
+            }
+            switchToFixedLength(size-sent+txbytes, fixed);
+            if (txbytes>threshold) {
+                // the FIFO drains 1 byte per byteTime()
+                uint16_t us = byteTime();
+                for (byte i=threshold; i<txbytes; i++) delayMicroseconds(us);
+                continue;
+            }
+            uint16_t n = BUFFER_SIZE-txbytes;
+            if (n>size-sent) n = size-sent;
+            writeBurstRegister(CC1101_TXFIFO, txBuffer+sent, n);
+            sent += n;
+        }
+        switchToFixedLength(0, fixed);
+        // we wait for IDLE state (RX with fast turnaround) or TXFIFO_UNDERFLOW
+        while (ok) {
+            byte state = getState();
+            if (txEnded(state)) break;
+            if (state==7) ok = false;
+            delayMicroseconds(byteTime());
+        }
+    }
+    if (infinite) writeRegisterNow(CC1101_PKTCTRL0, (regs[CC1101_PKTCTRL0] & 0xFC) | 2);
+    if (ok) {
+        CC1101_STAT(packetsSent, 1);
+        setIDLEstate();
+        strobe(CC1101_SFTX);
+        setRXstate();
+    }
+    return ok;
+}
+
+// The length byte and the payload with a single burst. Between the packets of sendBatch()
+// the chip starts the sync word as soon as the FIFO is not empty, the payload must follow.
+template <class Pins>
+void CC1101Radio<Pins>::writeFrame(FrameSource source, void *ctx, const uint16_t index) {
+    byte frame[MAX_PACKET_LEN+1];
+    byte size = source(ctx, index, frame+1);
+    CC1101_TRACE_EVENT(CC1101_TRACE_SEND, size);
+    frame[0] = size;
+    writeBurstRegister(CC1101_TXFIFO, frame, size+1);
+}
+
+template <class Pins>
+byte CC1101Radio<Pins>::sendBatch(const byte * const packets[], const byte sizes[], const byte count, bool sent[]) {
+    bool ok = packets!=NULL && sizes!=NULL;
+    for (byte i=0; ok && i<count; i++) ok = packets[i]!=NULL;
+    BatchArrays b = { packets, sizes };
+    return sendBatch(ok ? batchArrays : NULL, &b, count, sent);
+}
+
+template <class Pins>
+byte CC1101Radio<Pins>::sendBatch(CC1101FrameSource source, void *ctx, const byte count, bool sent[]) {
+    if (source==NULL) {
+        if (sent) for (byte i=0; i<count; i++) sent[i] = false;
+        CC1101_PRINTLN("sendBatch called with wrong arguments");
+        return 0;
+    }
+    BatchSource b = { source, ctx };
+    return sendFrames(batchSource, &b, count, sent);
+}
+
+template <class Pins>
+uint16_t CC1101Radio<Pins>::sendFrames(FrameSource source, void *ctx, const uint16_t count, bool sent[]) {
+    if (sent) for (uint16_t i=0; i<count; i++) sent[i] = false;
+    if (count==0 || (regs[CC1101_PKTCTRL0] & 3)!=1) {
+        CC1101_PRINTLN("sendBatch called with wrong arguments");
+        return 0;
+    }
+    for (uint16_t i=0; i<count; i++) {
+        byte size = source(ctx, i, NULL);
+        if (size==0 || size>MAX_PACKET_LEN) {
+            CC1101_PRINTLN("sendBatch called with wrong arguments");
+            return 0;
+        }
+    }
+    prepareTx();
+    // TXOFF_MODE=TX. regs[] keeps the normal value, it is restored before the last packet ends
+    writeRegister(CC1101_MCSM1, (regs[CC1101_MCSM1] & ~0x03) | 0x02);
+    // The FIFO is filled before STX with the packets that fit
+    uint16_t next = 0;
+    uint32_t written = 0; // bytes written to the FIFO
+    byte size = source(ctx, 0, NULL); // of the next packet
+    while (next<count && written+size+1<=BUFFER_SIZE) {
+        writeFrame(source, ctx, next);
+        written += size+1;
+        if (++next<count) size = source(ctx, next, NULL);
+    }
+    if (!fastTurnaround) delayMicroseconds(500);
+    if (!csmaStx()) {
+        // high RSSI
+        CC1101_STAT(ccaFails, 1);
+        CC1101_PRINTLN("send=false");
+        writeRegister(CC1101_MCSM1, regs[CC1101_MCSM1]);
+        setIDLEstate();
+        strobe(CC1101_SFTX);
+        setRXstate();
+        return 0;
+    }
+    // The FIFO has only complete packets and between them the chip sends preamble. An
+    // underflow is still possible if the MCU is very slow (interrupts) with a high data rate.
+    uint16_t us = byteTime();
+    byte lastSize = source(ctx, count-1, NULL);
+    while (1) {
+        byte txbytes = readFifoBytes(CC1101_TXBYTES);
+        if (txbytes & 0x80) {
+            // The packets that left the FIFO completely are on the air
+            uint32_t consumed = written - (txbytes & 0x7F);
+            uint32_t end = 0;
+            uint16_t done = 0;
+            while (done<next && end+source(ctx, done, NULL)+1<=consumed) {
+                end += source(ctx, done, NULL)+1;
+                if (sent) sent[done] = true;
+                done++;
+            }
+            CC1101_PRINTLN("TX FIFO underflow");
+            writeRegister(CC1101_MCSM1, regs[CC1101_MCSM1]);
+            setIDLEstate();
+            strobe(CC1101_SFTX);
+            setRXstate();
+            CC1101_STAT(packetsSent, done);
+            return done;
+        }
+        if (next==count) {
+            // the length byte of the last packet is read, the previous packet has ended
+            if (txbytes<lastSize+1) break;
+        } else if (BUFFER_SIZE-txbytes>=size+1) {
+            writeFrame(source, ctx, next);
+            written += size+1;
+            if (++next<count) size = source(ctx, next, NULL);
+            continue;
+        }
+        delayMicroseconds(us);
+    }
+    writeRegister(CC1101_MCSM1, regs[CC1101_MCSM1]);
+    // The last packet needs at most 61 bytes + CRC. If the restore came too late (a very
+    // short last packet) the chip sends preamble after it, and SIDLE stops it.
+    uint32_t t = micros();
+    uint32_t maxUs = (uint32_t)(MAX_PACKET_LEN+4)*us*4; // Manchester/FEC
+    while (1) {
+        byte state = getState();
+        if (txEnded(state)) break;
+        if (micros()-t>maxUs && readFifoBytes(CC1101_TXBYTES)==0) {
+            setIDLEstate();
+            break;
+        }
+        delayMicroseconds(us);
+    }
+    if (getState()==0) {
+        strobe(CC1101_SFTX);
+        setRXstate();
+    }
+    if (sent) for (uint16_t i=0; i<count; i++) sent[i] = true;
+    CC1101_STAT(packetsSent, count);
+    return count;
+}
+
+template <class Pins>
+uint16_t CC1101Radio<Pins>::getLongPacket(byte *rxBuffer, const uint16_t bufSize) {
+    byte rxbytes = readFifoBytes(CC1101_RXBYTES);
+    if (rxbytes & 0x80) {
+        CC1101_STAT(rxOverflows, 1);
+        CC1101_PRINTLN("RX FIFO overflow");
+        flushRx();
+        return 0;
+    }
+    if (rxbytes==0) return 0;
+    // A packet is arriving, we read it while it is on the air
+    bool infinite = (regs[CC1101_PKTCTRL0] & 3)==2;
+    bool fixed = !infinite;
+    byte headerLen = infinite ? 2 : 1;
+    byte threshold = 4*((regs[CC1101_FIFOTHR] & 0x0F)+1);
+    // no new byte for 16 byte periods (+2ms) means the packet is lost
+    uint32_t timeout = 2 + 16*8000ul/CC1101Calc::dataRate(regs[CC1101_MDMCFG4] & 0x0F, regs[CC1101_MDMCFG3]);
+    uint32_t t = millis();
+    uint16_t size = 0;
+    uint16_t got = 0;
+    bool header = false;
+    byte last = 0;
+    while (1) {
+        rxbytes = readFifoBytes(CC1101_RXBYTES);
+        if (rxbytes!=last) {
+            last = rxbytes;
+            t = millis();
+        } else if (millis()-t>timeout) {
+            CC1101_PRINTLN("getLongPacket timeout");
+            break;
+        }
+        if (rxbytes & 0x80) {
+            CC1101_STAT(rxOverflows, 1);
+            CC1101_PRINTLN("RX FIFO overflow");
+            break;
+        }
+        if (!header) {
+            // the errata does not allow reading the last byte of the FIFO during reception
+            if (rxbytes>headerLen) {
+                byte h[2];
+                readBurstRegister(CC1101_RXFIFO, h, headerLen);
+                size = infinite ? ((uint16_t)h[0]<<8) | h[1] : h[0];
+                if (size==0 || size>bufSize) {
+                    CC1101_STAT(wrongRxSize, 1);
+                    CC1101_PRINT("Wrong rx size=");
+                    CC1101_PRINTLN(size);
+                    break;
+                }
+                if (infinite) writeRegisterNow(CC1101_PKTLEN, (size+2) & 0xFF);
+                header = true;
+                rxbytes -= headerLen;
+            }
+        }
+        if (header) {
+            uint16_t left = size-got;
+            switchToFixedLength(left-rxbytes, fixed);
+            if (rxbytes>=left+2) {
+                // the end of the packet and the 2 status bytes
+                readBurstRegister(CC1101_RXFIFO, rxBuffer+got, left);
+                readBurstRegister(CC1101_RXFIFO, status, 2);
+                got = size;
+                break;
+            }
+            if (rxbytes>=threshold) {
+                byte n = rxbytes-1;
+                if (n>left) n = left;
+                readBurstRegister(CC1101_RXFIFO, rxBuffer+got, n);
+                got += n;
+            }
+        }
+    }
+    if (infinite) {
+        writeRegisterNow(CC1101_PKTCTRL0, (regs[CC1101_PKTCTRL0] & 0xFC) | 2);
+        writeRegisterNow(CC1101_PKTLEN, 255);
+    }
+    if (got!=size || size==0) {
+        flushRx();
+        memset(status,0,2);
+        return 0;
+    }
+    countRx(status[1]);
+    CC1101_TRACE_EVENT(CC1101_TRACE_RECEIVED, size>255 ? 255 : size);
+    if ( (regs[CC1101_MCSM1] & 0x0C) != 0x0C ) {
+        // RXOFF_MODE=IDLE as getPacket()
+        setIDLEstate();
+        strobe(CC1101_SFRX);
+        setRXstate();
+    }
+    return size;
+}
+
+// MCSM1 CCA_MODE=3. RXOFF_MODE=RX with stayInRx (multi packet and interrupt RX), otherwise
+// IDLE or FSTXON (fast turnaround). TXOFF_MODE=IDLE or RX (fast turnaround)
+template <class Pins>
+void CC1101Radio<Pins>::setOffModes(const bool stayInRx) {
+    byte mcsm1 = 0x30;
+    if (stayInRx) mcsm1 |= 0x0C;
+    else if (fastTurnaround) mcsm1 |= 0x04;
+    if (fastTurnaround) mcsm1 |= 0x03;
+    setRegister(CC1101_MCSM1, mcsm1);
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::enableFastTurnaround(const byte calEvery) {
+    fastTurnaround = true;
+    turnCalEvery = calEvery;
+    turnCount = 0;
+    setOffModes((regs[CC1101_MCSM1] & 0x0C)==0x0C);
+    // FS_AUTOCAL=1, the passes from IDLE calibrate (wor() sets 3). With calibrateChannels()
+    // FS_AUTOCAL stays 0 and the cached values are used.
+    if (channelCal==NULL) setRegister(CC1101_MCSM0, (regs[CC1101_MCSM0] & 0xCF) | 0x10);
+    commit();
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::disableFastTurnaround() {
+    fastTurnaround = false;
+    setOffModes((regs[CC1101_MCSM1] & 0x0C)==0x0C);
+    commit();
+}
+
+// The chip never passes from IDLE with fast turnaround, so FS_AUTOCAL does not calibrate
+// (FS_AUTOCAL=3 counts only RX/TX->IDLE transitions). Every turnCalEvery-th packet the
+// library takes the normal path through IDLE, which calibrates.
+template <class Pins>
+bool CC1101Radio<Pins>::turnaroundCalDue() {
+    if (turnCalEvery==0) return false;
+    if (++turnCount<turnCalEvery) return false;
+    turnCount = 0;
+    return true;
+}
+
+// The chip has left TX. With fast turnaround TXOFF_MODE is RX, and a reply of the peer
+// that arrives before the next check moves it to FSTXON (RXOFF_MODE) or RXFIFO_OVERFLOW.
+template <class Pins>
+bool CC1101Radio<Pins>::txEnded(const byte state) {
+    if (state==0) return true;
+    return fastTurnaround && (state==1 || state==3 || state==6);
+}
+
+template <class Pins>
+uint32_t CC1101Radio<Pins>::getTurnaroundUs() {
+    return turnaroundUs;
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::countState(const byte state) {
+    if (state==energyState) return;
+    updateEnergy();
+    energyState = state;
+}
+
+template <class Pins>
+byte CC1101Radio<Pins>::txState() {
+    if (paTable==CC1101Calc::paTable(5)) return CC1101Energy::TX_5DBM;
+    if (paTable==CC1101Calc::paTable(0)) return CC1101Energy::TX_0DBM;
+    return CC1101Energy::TX_10DBM;
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::enableEnergy(CC1101Energy& e) {
+    energy = &e;
+    energySince = micros();
+    // getState() would wake a sleeping chip
+    if (sleepStrobe==CC1101_SPWD) energyState = CC1101Energy::SLEEP;
+    else if (sleepStrobe==CC1101_SWOR) energyState = CC1101Energy::WOR;
+    else {
+        energyState = CC1101Energy::IDLE;
+        getState();
+    }
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::disableEnergy() {
+    updateEnergy();
+    energy = NULL;
+}
+
+// The time since the last update goes to the current state
+template <class Pins>
+void CC1101Radio<Pins>::updateEnergy() {
+    if (energy==NULL) return;
+    uint32_t now = micros();
+    uint32_t t = energy->us[energyState] + (now-energySince);
+    energy->ms[energyState] += t/1000;
+    energy->us[energyState] = t%1000;
+    energySince = now;
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::countRx(const byte lqiCrc) {
+    if (!stats) return;
+    stats->packetsReceived++;
+    if ( (lqiCrc & 0x80)==0 ) stats->crcErrors++;
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::enableStats(CC1101Stats& s) {
+    stats = &s;
+}
+
+template <class Pins>
+void CC1101Radio<Pins>::disableStats() {
+    stats = NULL;
+}
+
+template <class Pins>
+CC1101Radio<Pins> *CC1101Radio<Pins>::rxRadio = NULL;
+
+// CC1101 is compiled in CC1101_RF.cpp
+extern template class CC1101Radio<CC1101Pins>;
+
+// The macros are not for the sketch
+#undef CC1101_PRINTLN
+#undef CC1101_PRINT
+#undef CC1101_WRITE_BURST
+#undef CC1101_READ_SINGLE
+#undef CC1101_READ_BURST
+#undef CC1101_BYTES_IN_RXFIFO
+#undef CC1101_STAT
+#undef CC1101_TRACE_EVENT
+
+#endif